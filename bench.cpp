@@ -0,0 +1,616 @@
+// Микробенчмарки примитивов счетчика.
+// Сборка: g++ -O2 -std=c++17 bench.cpp platform.cpp timestamp.cpp logger.cpp log_segments.cpp log_events.cpp counter.cpp registry.cpp stats.cpp pool.cpp persist.cpp participants.cpp io_ring.cpp trace.cpp -pthread -o counter_bench
+#include "platform.h"
+#include "logger.h"
+#include "counter.h"
+#include "stats.h"
+#include "persist.h"
+#include "counter_policy.h"
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include <string>
+
+#ifndef _WIN32
+    #include <sys/resource.h>
+#endif
+
+SharedMemory* shared_mem = nullptr;
+Mutex* global_mutex = nullptr;
+
+static volatile size_t bench_sink = 0;
+
+static double now_seconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename F>
+static double ns_per_call(long iterations, F&& fn) {
+    double start = now_seconds();
+    for (long i = 0; i < iterations; i++) fn();
+    return (now_seconds() - start) * 1e9 / iterations;
+}
+
+static void bench_timestamp(long iterations) {
+    double legacy = ns_per_call(iterations, [] {
+        std::string formatted = format_timestamp(get_current_timestamp());
+        bench_sink += formatted[0];
+    });
+    
+    double cached = ns_per_call(iterations, [] {
+        char ts[TIMESTAMP_SIZE];
+        format_current_timestamp(ts, sizeof(ts));
+        bench_sink += ts[0];
+    });
+    
+    double legacy_line = ns_per_call(iterations, [] {
+        Timestamp ts = get_current_timestamp();
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "[%s] PID=%lld", format_timestamp(ts).c_str(), 1LL);
+        bench_sink += buffer[1];
+    });
+    
+    double cached_line = ns_per_call(iterations, [] {
+        char ts[TIMESTAMP_SIZE];
+        format_current_timestamp(ts, sizeof(ts));
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer), "[%s] PID=%lld", ts, 1LL);
+        bench_sink += buffer[1];
+    });
+    
+    printf("timestamp: %ld итераций, нс/вызов\n", iterations);
+    printf("  get_current_timestamp + format_timestamp: %8.1f (строка лога: %8.1f)\n", legacy, legacy_line);
+    printf("  format_current_timestamp:                 %8.1f (строка лога: %8.1f)\n", cached, cached_line);
+}
+
+// Стоимость одной контрольной точки (запись + msync или io_uring
+// write+fdatasync, см. persist.h) и восстановления (проверка обеих
+// страниц). Файл создается в текущем каталоге, поэтому результат зависит
+// от файловой системы.
+static void bench_checkpoint(long iterations, const char* path) {
+    LatencyHistogram store;
+    LatencyHistogram load;
+    store.reset();
+    load.reset();
+    const char* backend;
+    uint64_t syscalls;
+    
+    {
+        CheckpointFile file(path);
+        backend = file.uses_io_uring() ? "io_uring write+fdatasync" : "запись + msync";
+        uint64_t setup_syscalls = file.syscalls();
+        for (long i = 0; i < iterations; i++) {
+            uint64_t start = monotonic_ns();
+            file.store(i);
+            store.record(monotonic_ns() - start);
+            
+            start = monotonic_ns();
+            CheckpointRecord record;
+            bench_sink += file.load(&record) ? (size_t)record.value : 0;
+            load.record(monotonic_ns() - start);
+        }
+        syscalls = file.syscalls() - setup_syscalls;
+    }
+    remove(path);
+    
+    printf("checkpoint: %ld записей в %s, нс\n", iterations, path);
+    printf("  %s p50/p99/max: %llu / %llu / %llu, системных вызовов на запись: %.2f\n", backend,
+           (unsigned long long)store.percentile(0.5), (unsigned long long)store.percentile(0.99),
+           (unsigned long long)store.percentile(1.0), (double)syscalls / iterations);
+    printf("  восстановление p50/p99/max: %llu / %llu / %llu\n",
+           (unsigned long long)load.percentile(0.5), (unsigned long long)load.percentile(0.99),
+           (unsigned long long)load.percentile(1.0));
+}
+
+// Пачки лога через AsyncLogger: lines строк и flush() (ожидание записи в
+// файл) на каждую, синхронная запись против io_uring, с fdatasync и без.
+// Системные вызовы считает сам логгер (LogIoStats).
+static void bench_log_io(long batches, int lines, const char* path) {
+    printf("logio: %ld пачек по %d строк в %s, задержка flush() в нс\n", batches, lines, path);
+    
+    for (int fsync = 0; fsync <= 1; fsync++) {
+        for (int uring = 0; uring <= 1; uring++) {
+            LoggerConfig cfg = logger_config_from_env();
+            if (uring && !cfg.io_uring) continue;
+            cfg.io_uring = uring != 0;
+            cfg.fsync = fsync != 0;
+            cfg.flush_interval_ms = 1000;
+            cfg.max_batch = (size_t)lines + 1;
+            cfg.queue_capacity = (size_t)lines + 1;
+            cfg.segments.segment_bytes = 0;
+            cfg.segments.rotate_interval_s = 0;
+            
+            LatencyHistogram latency;
+            latency.reset();
+            LogIoStats stats;
+            {
+                AsyncLogger logger(path, cfg);
+                logger.flush();
+                LogIoStats before = logger.io_stats();
+                
+                char line[128];
+                for (long b = 0; b < batches; b++) {
+                    for (int i = 0; i < lines; i++) {
+                        snprintf(line, sizeof(line), "[bench] PID=%lld COUNTER=%ld", (long long)get_current_pid(), b * lines + i);
+                        logger.enqueue(line);
+                    }
+                    uint64_t start = monotonic_ns();
+                    logger.flush();
+                    latency.record(monotonic_ns() - start);
+                }
+                
+                stats = logger.io_stats();
+                stats.batches -= before.batches;
+                stats.syscalls -= before.syscalls;
+            }
+            remove(path);
+            
+            if (uring && !stats.io_uring) {
+                printf("  io_uring недоступен, используется синхронная запись\n");
+                continue;
+            }
+            printf("  %-8s fsync=%d: системных вызовов на пачку %.2f, p50/p99/max: %llu / %llu / %llu\n",
+                   uring ? "io_uring" : "writev", fsync,
+                   stats.batches ? (double)stats.syscalls / stats.batches : 0.0,
+                   (unsigned long long)latency.percentile(0.5), (unsigned long long)latency.percentile(0.99),
+                   (unsigned long long)latency.percentile(1.0));
+        }
+    }
+}
+
+#ifndef _WIN32
+static const char* BENCH_SHM_NAME = "/counter_bench_shm";
+
+// Запускает processes процессов, каждый вызывает op() в цикле duration
+// секунд, затем done(); возвращает суммарное число выполненных операций.
+template <typename F, typename D>
+static uint64_t run_processes(int processes, double duration, F&& op, D&& done) {
+    std::atomic<uint64_t>* totals = (std::atomic<uint64_t>*)mmap(NULL, sizeof(std::atomic<uint64_t>),
+                                                                 PROT_READ | PROT_WRITE,
+                                                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    totals->store(0);
+    
+    for (int p = 0; p < processes; p++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            double deadline = now_seconds() + duration;
+            uint64_t ops = 0;
+            do {
+                for (int i = 0; i < 256; i++) op();
+                ops += 256;
+            } while (now_seconds() < deadline);
+            done();
+            totals->fetch_add(ops);
+            _exit(0);
+        }
+    }
+    while (wait(nullptr) > 0) {}
+    
+    uint64_t total = totals->load();
+    munmap(totals, sizeof(std::atomic<uint64_t>));
+    return total;
+}
+
+template <typename F>
+static uint64_t run_processes(int processes, double duration, F&& op) {
+    return run_processes(processes, duration, op, [] {});
+}
+
+static void bench_counter(int max_processes, double duration) {
+    printf("counter: %.1f с на точку, инкрементов/с\n", duration);
+    printf("  %9s %14s %14s\n", "процессов", "atomic", "sharded");
+    
+    for (int processes = 1; processes <= max_processes; processes *= 2) {
+        double rates[2];
+        for (int sharded = 0; sharded < 2; sharded++) {
+            shm_unlink(BENCH_SHM_NAME);
+            setenv("COUNTER_SHARDED", sharded ? "1" : "0", 1);
+            SharedMemory shm(BENCH_SHM_NAME);
+            Mutex mutex(&shm);
+            SharedSegment* seg = shm.segment();
+            
+            uint64_t total = run_processes(processes, duration, [seg] { counter_add(seg, 1); });
+            rates[sharded] = total / duration;
+            
+            if (counter_read(seg) != (int64_t)total + 1) {
+                fprintf(stderr, "counter: сумма %lld не совпадает с числом инкрементов %llu\n",
+                        (long long)counter_read(seg), (unsigned long long)total);
+            }
+        }
+        printf("  %9d %14.0f %14.0f\n", processes, rates[0], rates[1]);
+    }
+    shm_unlink(BENCH_SHM_NAME);
+}
+#endif
+
+#ifndef _WIN32
+// counter_add против counter_increment: скорость, сколько вызовов
+// приходится на один перенос в общий счетчик и на сколько значение
+// counter_read отставало (от первой неперенесенной прибавки до переноса).
+static void bench_increment(int max_processes, double duration) {
+    printf("increment: %.1f с на точку, порог %d, интервал %d мс\n", duration,
+           env_int("COUNTER_DELTA_THRESHOLD", 4096), env_int("COUNTER_DELTA_FLUSH_MS", 10));
+    printf("  %9s %14s %14s %12s %24s\n", "процессов", "counter_add/с", "increment/с", "на перенос",
+           "отставание p50/p99/max мс");
+    
+    for (int processes = 1; processes <= max_processes; processes *= 2) {
+        double rates[2];
+        DeltaSummary summary;
+        for (int mode = 0; mode < 2; mode++) {
+            shm_unlink(BENCH_SHM_NAME);
+            setenv("COUNTER_SHARDED", "0", 1);
+            SharedMemory shm(BENCH_SHM_NAME);
+            SharedSegment* seg = shm.segment();
+            
+            uint64_t total = mode == 0
+                ? run_processes(processes, duration, [seg] { counter_add(seg, 1); })
+                : run_processes(processes, duration, [seg] { counter_increment(seg, 1); },
+                                [seg] { counter_deltas_shutdown(seg); });
+            rates[mode] = total / duration;
+            
+            int64_t exact = counter_read_exact(seg);
+            if (exact != (int64_t)total + 1) {
+                fprintf(stderr, "increment: сумма %lld не совпадает с числом инкрементов %llu\n",
+                        (long long)exact, (unsigned long long)total);
+            }
+            if (mode == 1) counter_delta_summary(seg, &summary);
+        }
+        printf("  %9d %14.0f %14.0f %12.0f %10.2f / %.2f / %.2f\n", processes, rates[0], rates[1],
+               summary.flushes ? (double)summary.calls / summary.flushes : 0.0,
+               summary.staleness_p50 / 1e6, summary.staleness_p99 / 1e6, summary.staleness_max / 1e6);
+    }
+    shm_unlink(BENCH_SHM_NAME);
+}
+#endif
+
+#ifndef _WIN32
+#define POLICY_SHM_NAME "/counter_policy_shm"
+#define POLICY_LOG_FILE "counter_policy_log.txt"
+#define POLICY_CHECKPOINT_FILE "counter_policy.ckpt"
+
+static void policy_cleanup() {
+    shm_unlink(POLICY_SHM_NAME);
+    ::remove(POLICY_LOG_FILE);
+    ::remove(log_binary_filename());
+    ::remove(POLICY_CHECKPOINT_FILE);
+}
+
+// Одна комбинация стратегий: processes процессов, каждый открывает свой
+// Counter и увеличивает его duration секунд с записью каждой операции в
+// лог. Сегмент создает родитель (без лога, чтобы не форкать процесс с
+// потоком AsyncLogger) и сверяет итог с числом операций; при RingLog он
+// же, как лидер в main, выгружает кольцо в файл, при FileStorage - пишет
+// контрольные точки.
+template <class L, class S, class G>
+static void bench_policy_one(int processes, double duration) {
+    policy_cleanup();
+    Counter<L, S, NullLog> owner(POLICY_SHM_NAME);
+    int64_t initial = owner.get();
+    
+    std::atomic<uint64_t>* totals = (std::atomic<uint64_t>*)mmap(NULL, sizeof(std::atomic<uint64_t>),
+                                                                 PROT_READ | PROT_WRITE,
+                                                                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    totals->store(0);
+    for (int p = 0; p < processes; p++) {
+        if (fork() == 0) {
+            uint64_t ops = 0;
+            {
+                Counter<L, S, G> counter(POLICY_SHM_NAME, true);
+                double deadline = now_seconds() + duration;
+                do {
+                    for (int i = 0; i < 256; i++) counter.add(1);
+                    ops += 256;
+                } while (now_seconds() < deadline);
+                log_shutdown();
+            }
+            totals->fetch_add(ops);
+            _exit(0);
+        }
+    }
+    
+    bool drain = strcmp(G::name(), RingLog::name()) == 0;
+    if (drain) {
+        RingLog::attach(owner.segment());
+        log_set_drainer(true);
+    }
+    Checkpointer* checkpointer = S::start_checkpoints(owner.segment());
+    
+    while (wait(nullptr) > 0) {}
+    
+    if (checkpointer) checkpointer->finish();
+    delete checkpointer;
+    if (drain) {
+        log_set_drainer(false);
+        log_attach_ring(nullptr);
+    }
+    
+    uint64_t total = totals->load();
+    munmap(totals, sizeof(std::atomic<uint64_t>));
+    
+    printf("  %-24s %14.0f%s\n", Counter<L, S, G>::describe().c_str(), total / duration,
+           owner.get() - initial == (int64_t)total ? "" : "  ОШИБКА: сумма не совпадает");
+    policy_cleanup();
+}
+
+template <class L, class S>
+static void bench_policy_logs(int processes, double duration) {
+    bench_policy_one<L, S, NullLog>(processes, duration);
+    bench_policy_one<L, S, RingLog>(processes, duration);
+    bench_policy_one<L, S, AsyncLog>(processes, duration);
+    bench_policy_one<L, S, SyncLog>(processes, duration);
+}
+
+template <class L>
+static void bench_policy_storages(int processes, double duration) {
+    bench_policy_logs<L, ShmStorage>(processes, duration);
+    bench_policy_logs<L, FileStorage>(processes, duration);
+}
+
+static void bench_policy(int processes, double duration) {
+    setenv("COUNTER_LOG_FILE", POLICY_LOG_FILE, 1);
+    setenv("COUNTER_PERSIST", POLICY_CHECKPOINT_FILE, 1);
+    printf("policy: %d процессов, %.1f с на комбинацию, операций/с\n", processes, duration);
+    printf("  %-24s %14s\n", "блокировка/память/лог", "add");
+#ifdef COUNTER_POLICY_LOCK
+    bench_policy_one<COUNTER_POLICY_LOCK, COUNTER_POLICY_STORAGE, COUNTER_POLICY_LOG>(processes, duration);
+#else
+    bench_policy_storages<AtomicLock>(processes, duration);
+    bench_policy_storages<MutexLock>(processes, duration);
+#endif
+}
+
+struct ContentionOptions {
+    std::string op;
+    int processes;
+    int threads;
+    double seconds;
+    uint64_t seed;
+    int work;
+    bool csv;
+};
+
+struct ContentionResult {
+    std::atomic<uint64_t> ops;
+    std::atomic<uint64_t> cpu_ns;
+    LatencyHistogram latency;
+};
+
+static inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static void contention_worker(const ContentionOptions& opt, int proc, int thread,
+                              SharedSegment* seg, Mutex* mutex,
+                              LatencyHistogram* latency, uint64_t* ops_out) {
+    uint64_t rng = opt.seed ^ ((uint64_t)proc << 32) ^ (uint64_t)thread;
+    uint64_t deadline = monotonic_ns() + (uint64_t)(opt.seconds * 1e9);
+    uint64_t ops = 0;
+    volatile uint64_t spin_sink = 0;
+    
+    char line[128];
+    snprintf(line, sizeof(line), "[bench] PID=%lld THREAD=%d CONTENTION",
+             (long long)get_current_pid(), thread);
+    
+    bool use_mutex = opt.op == "mutex";
+    bool use_log = opt.op == "log";
+    
+    while (true) {
+        for (int i = 0; i < 64; i++) {
+            uint64_t start = monotonic_ns();
+            if (use_mutex) {
+                mutex->lock();
+                latency->record(monotonic_ns() - start);
+                seg->counter.value.fetch_add(1, std::memory_order_relaxed);
+                mutex->unlock();
+            } else if (use_log) {
+                log_message(line);
+                latency->record(monotonic_ns() - start);
+            } else {
+                counter_add(seg, 1);
+                latency->record(monotonic_ns() - start);
+            }
+            
+            if (opt.work > 0) {
+                uint64_t spins = splitmix64(rng) % (uint64_t)(opt.work + 1);
+                for (uint64_t k = 0; k < spins; k++) spin_sink += k;
+            }
+        }
+        ops += 64;
+        if (monotonic_ns() >= deadline) break;
+    }
+    *ops_out = ops;
+}
+
+static void bench_contention(const ContentionOptions& opt) {
+    if (opt.op != "mutex" && opt.op != "atomic" && opt.op != "sharded" && opt.op != "log") {
+        fprintf(stderr, "contention: неизвестная операция %s\n", opt.op.c_str());
+        return;
+    }
+    
+    shm_unlink(BENCH_SHM_NAME);
+    setenv("COUNTER_SHARDED", opt.op == "sharded" ? "1" : "0", 1);
+    setenv("COUNTER_LOG_FILE", "counter_bench_log.txt", 0);
+    SharedMemory shm(BENCH_SHM_NAME);
+    Mutex mutex(&shm);
+    SharedSegment* seg = shm.segment();
+    if (opt.op == "log") log_attach_ring(&seg->log_ring);
+    
+    ContentionResult* result = (ContentionResult*)mmap(NULL, sizeof(ContentionResult),
+                                                       PROT_READ | PROT_WRITE,
+                                                       MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    memset((void*)result, 0, sizeof(ContentionResult));
+    
+    for (int p = 0; p < opt.processes; p++) {
+        if (fork() != 0) continue;
+        
+        std::vector<LatencyHistogram> latency(opt.threads);
+        std::vector<uint64_t> ops(opt.threads, 0);
+        for (LatencyHistogram& h : latency) h.reset();
+        
+        std::vector<std::thread> threads;
+        for (int t = 0; t < opt.threads; t++) {
+            threads.emplace_back(contention_worker, std::cref(opt), p, t, seg, &mutex, &latency[t], &ops[t]);
+        }
+        for (std::thread& t : threads) t.join();
+        
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        uint64_t cpu_ns = (uint64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull
+                        + (uint64_t)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+        
+        for (int t = 0; t < opt.threads; t++) {
+            result->ops.fetch_add(ops[t]);
+            result->latency.merge(latency[t]);
+        }
+        result->cpu_ns.fetch_add(cpu_ns);
+        _exit(0);
+    }
+    
+    if (opt.op == "log") log_set_drainer(true);
+    while (wait(nullptr) > 0) {}
+    if (opt.op == "log") log_shutdown();
+    
+    uint64_t ops = result->ops.load();
+    double ops_per_sec = ops / opt.seconds;
+    double cpu_per_op = ops ? (double)result->cpu_ns.load() / ops : 0.0;
+    uint64_t p50 = result->latency.percentile(0.50);
+    uint64_t p99 = result->latency.percentile(0.99);
+    uint64_t p999 = result->latency.percentile(0.999);
+    
+    if (opt.csv) {
+        printf("op,procs,threads,seconds,seed,work,ops,ops_per_sec,p50_ns,p99_ns,p999_ns,cpu_ns_per_op\n");
+        printf("%s,%d,%d,%.3f,%llu,%d,%llu,%.0f,%llu,%llu,%llu,%.1f\n",
+               opt.op.c_str(), opt.processes, opt.threads, opt.seconds,
+               (unsigned long long)opt.seed, opt.work, (unsigned long long)ops, ops_per_sec,
+               (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999, cpu_per_op);
+    } else {
+        printf("contention: op=%s процессов=%d потоков=%d секунд=%.1f seed=%llu work=%d\n",
+               opt.op.c_str(), opt.processes, opt.threads, opt.seconds,
+               (unsigned long long)opt.seed, opt.work);
+        printf("  операций/с:            %.0f\n", ops_per_sec);
+        printf("  задержка p50/p99/p999: %llu / %llu / %llu нс\n",
+               (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999);
+        printf("  CPU на операцию:       %.1f нс\n", cpu_per_op);
+    }
+    
+    munmap(result, sizeof(ContentionResult));
+    shm_unlink(BENCH_SHM_NAME);
+}
+
+static bool parse_contention_options(int argc, char* argv[], ContentionOptions& opt) {
+    opt.op = "mutex";
+    opt.processes = 4;
+    opt.threads = 1;
+    opt.seconds = 2.0;
+    opt.seed = 1;
+    opt.work = 0;
+    opt.csv = false;
+    
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--csv") opt.csv = true;
+        else if (arg == "--op" && has_value) opt.op = argv[++i];
+        else if (arg == "--procs" && has_value) opt.processes = atoi(argv[++i]);
+        else if (arg == "--threads" && has_value) opt.threads = atoi(argv[++i]);
+        else if (arg == "--seconds" && has_value) opt.seconds = atof(argv[++i]);
+        else if (arg == "--seed" && has_value) opt.seed = strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--work" && has_value) opt.work = atoi(argv[++i]);
+        else return false;
+    }
+    return opt.processes > 0 && opt.threads > 0 && opt.seconds > 0;
+}
+#endif
+
+static void usage() {
+    std::cout << "Использование:\n"
+              << "  counter_bench timestamp [итераций]\n"
+              << "  counter_bench counter [макс. процессов] [секунд на точку]\n"
+              << "  counter_bench increment [макс. процессов] [секунд на точку]\n"
+              << "  counter_bench checkpoint [записей] [файл]\n"
+              << "  counter_bench logio [пачек] [строк в пачке]\n"
+              << "  counter_bench policy [процессов] [секунд на комбинацию]\n"
+              << "  counter_bench contention [--op mutex|atomic|sharded|log] [--procs N] [--threads M]\n"
+              << "                           [--seconds D] [--seed S] [--work W] [--csv]\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+    
+    if (strcmp(argv[1], "timestamp") == 0) {
+        long iterations = argc > 2 ? atol(argv[2]) : 2000000;
+        bench_timestamp(iterations);
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "checkpoint") == 0) {
+        long iterations = argc > 2 ? atol(argv[2]) : 1000;
+        bench_checkpoint(iterations, argc > 3 ? argv[3] : "counter_bench.ckpt");
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "logio") == 0) {
+        long batches = argc > 2 ? atol(argv[2]) : 2000;
+        int lines = argc > 3 ? atoi(argv[3]) : 64;
+        if (lines < 1) lines = 1;
+        bench_log_io(batches, lines, "counter_bench_log.txt");
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "counter") == 0) {
+#ifdef _WIN32
+        std::cout << "counter: требуется POSIX fork()\n";
+#else
+        int max_processes = argc > 2 ? atoi(argv[2]) : 64;
+        double duration = argc > 3 ? atof(argv[3]) : 1.0;
+        bench_counter(max_processes, duration);
+#endif
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "increment") == 0) {
+#ifdef _WIN32
+        std::cout << "increment: требуется POSIX fork()\n";
+#else
+        int max_processes = argc > 2 ? atoi(argv[2]) : 8;
+        double duration = argc > 3 ? atof(argv[3]) : 1.0;
+        bench_increment(max_processes, duration);
+#endif
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "policy") == 0) {
+#ifdef _WIN32
+        std::cout << "policy: требуется POSIX fork()\n";
+#else
+        int processes = argc > 2 ? atoi(argv[2]) : 4;
+        double duration = argc > 3 ? atof(argv[3]) : 0.5;
+        bench_policy(processes, duration);
+#endif
+        return 0;
+    }
+    
+    if (strcmp(argv[1], "contention") == 0) {
+#ifdef _WIN32
+        std::cout << "contention: требуется POSIX fork()\n";
+#else
+        ContentionOptions opt;
+        if (!parse_contention_options(argc, argv, opt)) {
+            usage();
+            return 1;
+        }
+        bench_contention(opt);
+#endif
+        return 0;
+    }
+    
+    usage();
+    return 1;
+}
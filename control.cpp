@@ -0,0 +1,291 @@
+#include "control.h"
+#include "counter.h"
+#include <sstream>
+
+#ifdef __linux__
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <cstddef>
+#endif
+
+const char* control_socket_name() {
+    const char* name = getenv("COUNTER_CONTROL");
+    return name && *name ? name : "@counter_control";
+}
+
+ControlServer::ControlServer(EventLoop* loop, SharedMemory* shm, Mutex* mutex, CounterRegistry* registry)
+    : loop(loop), shm(shm), mutex(mutex), registry(registry), listen_fd(-1), requests(0) {}
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+bool ControlServer::listening() const {
+    return listen_fd != -1;
+}
+
+size_t ControlServer::client_count() const {
+    return clients.size();
+}
+
+uint64_t ControlServer::request_count() const {
+    return requests;
+}
+
+static void append_reply(std::string& out, const char* status, int64_t value) {
+    char line[64];
+    int n = snprintf(line, sizeof(line), "%s %lld\n", status, (long long)value);
+    out.append(line, (size_t)n);
+}
+
+static bool parse_number(const std::string& text, int64_t* value) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    errno = 0;
+    long long parsed = strtoll(text.c_str(), &end, 10);
+    if (errno != 0 || *end != '\0') return false;
+    *value = parsed;
+    return true;
+}
+
+void ControlServer::execute(const std::string& line, std::string& out) {
+    requests++;
+    metric_add(shm->segment()->metrics.control_requests);
+    
+    std::istringstream args(line);
+    std::string verb, first, second, extra;
+    args >> verb >> first >> second >> extra;
+    for (char& c : verb) c = (char)toupper((unsigned char)c);
+    
+    SharedSegment* seg = shm->segment();
+    int64_t number = 0;
+    
+    if (!extra.empty()) {
+        out += "ERR too many arguments\n";
+    } else if (verb == "GET" && first.empty()) {
+        append_reply(out, "OK", counter_read(seg));
+    } else if ((verb == "SET" || verb == "ADD") && second.empty()) {
+        if (!parse_number(first, &number)) {
+            out += "ERR bad number\n";
+        } else if (verb == "SET") {
+            counter_set(seg, mutex, number);
+            metric_add(seg->metrics.sets);
+            append_reply(out, "OK", number);
+        } else {
+            metric_add(seg->metrics.increments);
+            CounterOp op = counter_op(OP_ADD, number);
+            append_reply(out, "OK", counter_apply(seg, mutex, &op, 1).after);
+        }
+    } else if (verb == "GET" && first == "--exact") {
+        append_reply(out, "OK", counter_read_exact(seg));
+    } else if (verb == "GET" && second.empty()) {
+        if (registry->get(first.c_str(), &number)) append_reply(out, "OK", number);
+        else out += "ERR not found\n";
+    } else if (verb == "SET" || verb == "ADD") {
+        if (!CounterRegistry::valid_name(first.c_str())) {
+            out += "ERR bad name\n";
+        } else if (!parse_number(second, &number)) {
+            out += "ERR bad number\n";
+        } else if (verb == "SET") {
+            if (registry->set(first.c_str(), number)) append_reply(out, "OK", number);
+            else out += "ERR registry full\n";
+        } else {
+            int64_t result;
+            if (registry->add(first.c_str(), number, &result)) append_reply(out, "OK", result);
+            else out += "ERR registry full\n";
+        }
+    } else if (verb == "STATS" && first.empty()) {
+        CounterSnapshot snap;
+        counter_snapshot(seg, &snap);
+        char reply[256];
+        int n = snprintf(reply, sizeof(reply),
+                         "OK value=%lld leader=%lld%s clients=%zu requests=%llu named=%u\n",
+                         (long long)snap.value,
+                         (long long)snap.leader_pid,
+                         snap.consistent ? "" : " inconsistent=1",
+                         clients.size(),
+                         (unsigned long long)requests,
+                         registry->size());
+        out.append(reply, (size_t)n);
+    } else {
+        out += "ERR unknown command\n";
+    }
+}
+
+#ifdef __linux__
+
+static socklen_t socket_address(const char* name, struct sockaddr_un* addr) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    
+    bool abstract = name[0] == '@';
+    const char* path = abstract ? name + 1 : name;
+    size_t length = strlen(path);
+    if (length + 1 > sizeof(addr->sun_path)) length = sizeof(addr->sun_path) - 1;
+    memcpy(addr->sun_path + (abstract ? 1 : 0), path, length);
+    
+    return (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length + (abstract ? 1 : 0));
+}
+
+bool ControlServer::start() {
+    if (listen_fd != -1) return true;
+    
+    const char* name = control_socket_name();
+    struct sockaddr_un addr;
+    socklen_t addr_len = socket_address(name, &addr);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        perror("socket");
+        return false;
+    }
+    
+    // Файл сокета остается от упавшего лидера; слушать может только
+    // текущий лидер, поэтому его можно удалить.
+    if (name[0] != '@') unlink(name);
+    
+    if (bind(fd, (struct sockaddr*)&addr, addr_len) == -1 || listen(fd, 128) == -1) {
+        perror("bind/listen");
+        close(fd);
+        return false;
+    }
+    
+    listen_fd = fd;
+    loop->add_fd(listen_fd, [this] { accept_clients(); });
+    return true;
+}
+
+void ControlServer::stop() {
+    while (!clients.empty()) close_client(clients.begin()->first);
+    
+    if (listen_fd == -1) return;
+    loop->remove_fd(listen_fd);
+    close(listen_fd);
+    listen_fd = -1;
+    
+    const char* name = control_socket_name();
+    if (name[0] != '@') unlink(name);
+}
+
+void ControlServer::accept_clients() {
+    while (true) {
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd == -1) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        
+        Client& client = clients[fd];
+        client.discarding = false;
+        client.paused = false;
+        client.writing = false;
+        client.closing = false;
+        loop->add_fd(fd, [this, fd] { read_client(fd); }, [this, fd] { flush_client(fd); });
+    }
+}
+
+void ControlServer::read_client(int fd) {
+    std::map<int, Client>::iterator it = clients.find(fd);
+    if (it == clients.end()) return;
+    Client& client = it->second;
+    
+    char chunk[16384];
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno != EAGAIN && errno != EINTR) {
+        close_client(fd);
+        return;
+    }
+    if (n < 0) return;
+    
+    // Клиент закрыл свою сторону: ответы на уже принятые команды
+    // дописываются, затем соединение закрывается.
+    if (n == 0) {
+        take_lines(client, true);
+        client.closing = true;
+        client.paused = true;
+        loop->set_fd_events(fd, false, true);
+        client.writing = true;
+        flush_client(fd);
+        return;
+    }
+    
+    client.in.append(chunk, (size_t)n);
+    take_lines(client, false);
+    flush_client(fd);
+}
+
+// Выполняет полные строки из client.in (при at_eof - и незавершенную
+// последнюю) и сдвигает буфер один раз.
+void ControlServer::take_lines(Client& client, bool at_eof) {
+    size_t start = 0;
+    while (start < client.in.size()) {
+        size_t end = client.in.find('\n', start);
+        bool complete = end != std::string::npos;
+        if (!complete) {
+            if (!at_eof && client.in.size() - start <= CONTROL_MAX_LINE) break;
+            end = client.in.size();
+        }
+        
+        size_t length = end - start;
+        if (length > 0 && client.in[end - 1] == '\r') length--;
+        if (client.discarding) {
+            client.discarding = !complete;
+        } else if (length > CONTROL_MAX_LINE) {
+            client.out += "ERR line too long\n";
+            client.discarding = !complete;
+        } else if (length > 0) {
+            execute(client.in.substr(start, length), client.out);
+        }
+        start = complete ? end + 1 : end;
+    }
+    client.in.erase(0, start);
+}
+
+void ControlServer::flush_client(int fd) {
+    std::map<int, Client>::iterator it = clients.find(fd);
+    if (it == clients.end()) return;
+    Client& client = it->second;
+    
+    // Отправленное удаляется из out один раз, после цикла.
+    size_t sent = 0;
+    while (sent < client.out.size()) {
+        ssize_t n = send(fd, client.out.data() + sent, client.out.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) break;
+            close_client(fd);
+            return;
+        }
+        sent += (size_t)n;
+    }
+    client.out.erase(0, sent);
+    
+    if (client.closing) {
+        if (client.out.empty()) close_client(fd);
+        return;
+    }
+    
+    bool paused = client.out.size() > CONTROL_MAX_PENDING;
+    bool writing = !client.out.empty();
+    if (paused != client.paused || writing != client.writing) {
+        loop->set_fd_events(fd, !paused, writing);
+        client.paused = paused;
+        client.writing = writing;
+    }
+}
+
+void ControlServer::close_client(int fd) {
+    loop->remove_fd(fd);
+    close(fd);
+    clients.erase(fd);
+}
+
+#else
+
+bool ControlServer::start() {
+    return false;
+}
+
+void ControlServer::stop() {}
+
+#endif
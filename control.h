@@ -0,0 +1,71 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "platform.h"
+#include "event_loop.h"
+#include "registry.h"
+#include <map>
+
+// Управляющий сервер лидера на Unix-сокете (только Linux). Имя сокета -
+// COUNTER_CONTROL, по умолчанию "@counter_control"; ведущий '@' означает
+// абстрактное пространство имен, иначе это путь в файловой системе.
+//
+// Протокол строковый, по команде на строку; ответ - тоже строка:
+//   GET                -> OK <значение>
+//   GET --exact        -> OK <значение с неперенесенными дельтами counter_increment>
+//   SET N | ADD N      -> OK <новое значение>
+//   GET NAME           -> OK <значение> | ERR not found
+//   SET NAME N         -> OK N
+//   ADD NAME N         -> OK <новое значение>
+//   STATS              -> OK value=... leader=... clients=... requests=...
+//   иначе              -> ERR <причина>
+// Клиент может отправить сколько угодно команд, не дожидаясь ответов:
+// все полные строки из прочитанного обрабатываются сразу, а ответы на них
+// уходят одним write. Пока у клиента скопилось больше CONTROL_MAX_PENDING
+// байт неотправленных ответов, его команды не читаются. На строку длиннее
+// CONTROL_MAX_LINE отвечается ошибкой, а ее остаток до '\n' пропускается;
+// последняя строка без '\n' перед закрытием соединения выполняется.
+
+#define CONTROL_MAX_LINE 256
+#define CONTROL_MAX_PENDING (1 << 20)
+
+const char* control_socket_name();
+
+class ControlServer {
+public:
+    ControlServer(EventLoop* loop, SharedMemory* shm, Mutex* mutex, CounterRegistry* registry);
+    ~ControlServer();
+    
+    bool start();
+    void stop();
+    bool listening() const;
+    size_t client_count() const;
+    uint64_t request_count() const;
+    
+private:
+    struct Client {
+        std::string in;
+        std::string out;
+        bool discarding;    // пропуск остатка слишком длинной строки
+        bool paused;
+        bool writing;
+        bool closing;
+    };
+    
+    EventLoop* loop;
+    SharedMemory* shm;
+    Mutex* mutex;
+    CounterRegistry* registry;
+    int listen_fd;
+    uint64_t requests;
+    std::map<int, Client> clients;
+    
+    void accept_clients();
+    void read_client(int fd);
+    void flush_client(int fd);
+    void close_client(int fd);
+    void take_lines(Client& client, bool at_eof);
+    void execute(const std::string& line, std::string& out);
+};
+
+#endif
@@ -0,0 +1,419 @@
+#include "counter.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifndef _WIN32
+    #include <sched.h>
+#endif
+
+static inline CounterShard& local_shard(SharedSegment* seg) {
+#ifdef _WIN32
+    unsigned cpu = GetCurrentProcessorNumber();
+#else
+    int cpu = sched_getcpu();
+    if (cpu < 0) cpu = (int)get_current_pid();
+#endif
+    return seg->shards[(unsigned)cpu % COUNTER_SHARDS];
+}
+
+static int64_t sum_shards(SharedSegment* seg) {
+    int64_t sum = 0;
+    for (int i = 0; i < COUNTER_SHARDS; i++) {
+        sum += seg->shards[i].delta.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+int64_t counter_read(SharedSegment* seg) {
+    SharedCounter& sc = seg->counter;
+    if (!sc.sharded) return sc.value.load();
+    
+    while (true) {
+        uint64_t epoch = sc.shard_epoch.load(std::memory_order_acquire);
+        if (epoch & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        
+        int64_t result = sc.value.load(std::memory_order_acquire) + sum_shards(seg);
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sc.shard_epoch.load(std::memory_order_relaxed) == epoch) return result;
+    }
+}
+
+void counter_snapshot(SharedSegment* seg, CounterSnapshot* out) {
+    SharedCounter& sc = seg->counter;
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    
+    out->consistent = false;
+    for (int attempt = 0; attempt < COUNTER_SNAPSHOT_RETRIES; attempt++) {
+        uint64_t seq = sc.state_seq.load(std::memory_order_acquire);
+        if (seq & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        
+        out->leader_pid = sc.leader_pid.load(relaxed);
+        out->last_leader_activity = sc.last_leader_activity.load(relaxed);
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sc.state_seq.load(relaxed) == seq) {
+            out->consistent = true;
+            break;
+        }
+    }
+    if (!out->consistent) {
+        out->leader_pid = sc.leader_pid.load(relaxed);
+        out->last_leader_activity = sc.last_leader_activity.load(relaxed);
+    }
+    
+    out->value = counter_read(seg);
+}
+
+void counter_add(SharedSegment* seg, int64_t delta) {
+    SharedCounter& sc = seg->counter;
+    trace_begin(TRACE_INCREMENT, delta);
+    if (!sc.sharded) {
+        sc.value.fetch_add(delta);
+    } else {
+        local_shard(seg).delta.fetch_add(delta, std::memory_order_relaxed);
+    }
+    trace_end(TRACE_INCREMENT, delta);
+}
+
+struct DeltaConfig {
+    int64_t threshold;
+    int flush_ms;
+};
+
+static const DeltaConfig& delta_config() {
+    static const DeltaConfig config = {
+        std::max(1, env_int("COUNTER_DELTA_THRESHOLD", 4096)),
+        std::max(1, env_int("COUNTER_DELTA_FLUSH_MS", 10))
+    };
+    return config;
+}
+
+// Фоновый перенос дельт процесса. delta_generation меняется при остановке
+// и в потомке после fork: слоты, занятые потоками раньше, им больше не
+// принадлежат, и поток переноса прежнего поколения завершается.
+static std::mutex delta_mutex;
+static std::condition_variable delta_cv;
+static std::thread* delta_flusher = nullptr;
+static SharedSegment* delta_segment = nullptr;
+static std::atomic<uint64_t> delta_generation(0);
+
+struct LocalDelta {
+    SharedSegment* seg;
+    DeltaSlot* slot;
+    int64_t threshold;
+    uint64_t generation;
+    
+    ~LocalDelta();
+};
+
+static thread_local LocalDelta local_delta = { nullptr, nullptr, 0, 0 };
+
+// Переносит дельту слота в счетчик; возвращает перенесенное.
+static int64_t flush_delta_slot(SharedSegment* seg, DeltaSlot& slot) {
+    if (slot.delta.load(std::memory_order_relaxed) == 0) return 0;
+    uint64_t first = slot.first_ns.load(std::memory_order_relaxed);
+    int64_t delta = slot.delta.exchange(0, std::memory_order_acq_rel);
+    if (delta == 0) return 0;
+    counter_add(seg, delta);
+    
+    DeltaTable& table = seg->deltas;
+    metric_add(table.flushes);
+    uint64_t now = monotonic_ns();
+    uint64_t staleness = first != 0 && now > first ? now - first : 0;
+    table.staleness.record(staleness);
+    uint64_t max = table.max_staleness_ns.load(std::memory_order_relaxed);
+    while (staleness > max && !table.max_staleness_ns.compare_exchange_weak(max, staleness, std::memory_order_relaxed)) {}
+    return delta;
+}
+
+static DeltaSlot* claim_delta_slot(SharedSegment* seg) {
+    int64_t me = (int64_t)get_current_pid();
+    for (int i = 0; i < DELTA_SLOTS; i++) {
+        DeltaSlot& slot = seg->deltas.slots[i];
+        int64_t expected = 0;
+        if (slot.owner.compare_exchange_strong(expected, me, std::memory_order_acquire)) return &slot;
+    }
+    return nullptr;
+}
+
+static void release_delta_slot(SharedSegment* seg, DeltaSlot& slot) {
+    flush_delta_slot(seg, slot);
+    slot.owner.store(0, std::memory_order_release);
+}
+
+// Дельты потоков этого процесса; reclaim - заодно перенести дельты
+// умерших процессов и освободить их слоты.
+static void flush_process_deltas(SharedSegment* seg, bool reclaim) {
+    int64_t me = (int64_t)get_current_pid();
+    for (int i = 0; i < DELTA_SLOTS; i++) {
+        DeltaSlot& slot = seg->deltas.slots[i];
+        int64_t owner = slot.owner.load(std::memory_order_acquire);
+        if (owner == me) {
+            flush_delta_slot(seg, slot);
+        } else if (reclaim && owner > 0 && !is_process_alive((platform_pid_t)owner) &&
+                   slot.owner.compare_exchange_strong(owner, -1)) {
+            release_delta_slot(seg, slot);
+        }
+    }
+}
+
+static void delta_flusher_loop(uint64_t generation) {
+    int interval = delta_config().flush_ms;
+    int elapsed = 0;
+    std::unique_lock<std::mutex> guard(delta_mutex);
+    
+    while (true) {
+        delta_cv.wait_for(guard, std::chrono::milliseconds(interval));
+        if (delta_generation.load() != generation) break;
+        
+        SharedSegment* seg = delta_segment;
+        elapsed += interval;
+        bool reclaim = elapsed >= 1000;
+        if (reclaim) elapsed = 0;
+        
+        guard.unlock();
+        flush_process_deltas(seg, reclaim);
+        guard.lock();
+    }
+}
+
+#ifndef _WIN32
+static void delta_fork_prepare() {
+    delta_mutex.lock();
+}
+
+static void delta_fork_parent() {
+    delta_mutex.unlock();
+}
+
+// Поток переноса в потомок не копируется, слоты остаются родителю.
+static void delta_fork_child() {
+    delta_flusher = nullptr;
+    delta_segment = nullptr;
+    delta_generation.fetch_add(1);
+    delta_mutex.unlock();
+}
+#endif
+
+static void start_delta_flusher(SharedSegment* seg) {
+    std::lock_guard<std::mutex> guard(delta_mutex);
+    if (delta_flusher) return;
+#ifndef _WIN32
+    static bool fork_handlers = false;
+    if (!fork_handlers) {
+        pthread_atfork(delta_fork_prepare, delta_fork_parent, delta_fork_child);
+        fork_handlers = true;
+    }
+#endif
+    delta_segment = seg;
+    delta_flusher = new std::thread(delta_flusher_loop, delta_generation.load());
+}
+
+LocalDelta::~LocalDelta() {
+    if (slot && generation == delta_generation.load()) release_delta_slot(seg, *slot);
+}
+
+static void attach_local_delta(SharedSegment* seg) {
+    LocalDelta& local = local_delta;
+    if (local.slot && local.generation == delta_generation.load()) release_delta_slot(local.seg, *local.slot);
+    
+    local.seg = seg;
+    local.generation = delta_generation.load();
+    local.threshold = delta_config().threshold;
+    local.slot = claim_delta_slot(seg);
+    if (local.slot) start_delta_flusher(seg);
+}
+
+void counter_increment(SharedSegment* seg, int64_t n) {
+    LocalDelta& local = local_delta;
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    if (local.seg != seg || local.generation != delta_generation.load(relaxed)) attach_local_delta(seg);
+    
+    DeltaSlot* slot = local.slot;
+    if (!slot) {
+        counter_add(seg, n);
+        return;
+    }
+    
+    slot->calls.store(slot->calls.load(relaxed) + 1, relaxed);
+    int64_t before = slot->delta.fetch_add(n, relaxed);
+    if (before == 0) slot->first_ns.store(monotonic_ns(), relaxed);
+    int64_t after = before + n;
+    if (after >= local.threshold || after <= -local.threshold) flush_delta_slot(seg, *slot);
+}
+
+int64_t counter_read_exact(SharedSegment* seg) {
+    for (int i = 0; i < DELTA_SLOTS; i++) flush_delta_slot(seg, seg->deltas.slots[i]);
+    return counter_read(seg);
+}
+
+void counter_deltas_shutdown(SharedSegment* seg) {
+    std::thread* flusher;
+    {
+        std::lock_guard<std::mutex> guard(delta_mutex);
+        flusher = delta_flusher;
+        delta_flusher = nullptr;
+        delta_segment = nullptr;
+        delta_generation.fetch_add(1);
+    }
+    delta_cv.notify_all();
+    if (flusher) {
+        flusher->join();
+        delete flusher;
+    }
+    
+    int64_t me = (int64_t)get_current_pid();
+    for (int i = 0; i < DELTA_SLOTS; i++) {
+        DeltaSlot& slot = seg->deltas.slots[i];
+        if (slot.owner.load(std::memory_order_acquire) == me) release_delta_slot(seg, slot);
+    }
+}
+
+void counter_delta_summary(SharedSegment* seg, DeltaSummary* out) {
+    const DeltaTable& table = seg->deltas;
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < DELTA_SLOTS; i++) {
+        const DeltaSlot& slot = table.slots[i];
+        out->calls += slot.calls.load(std::memory_order_relaxed);
+        out->pending += slot.delta.load(std::memory_order_relaxed);
+        if (slot.owner.load(std::memory_order_relaxed) != 0) out->slots++;
+    }
+    out->flushes = table.flushes.load(std::memory_order_relaxed);
+    out->staleness_p50 = table.staleness.percentile(0.5);
+    out->staleness_p99 = table.staleness.percentile(0.99);
+    out->staleness_max = table.max_staleness_ns.load(std::memory_order_relaxed);
+}
+
+static int64_t apply_op(const CounterOp& op, int64_t value) {
+    switch (op.kind) {
+    case OP_ADD:   return value + op.a;
+    case OP_MUL:   return value * op.a;
+    case OP_DIV:   return op.a != 0 ? value / op.a : value;
+    case OP_SET:   return op.a;
+    case OP_CLAMP: return value < op.a ? op.a : (value > op.b ? op.b : value);
+    }
+    return value;
+}
+
+static bool resets_value(const CounterOp* ops, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (ops[i].kind == OP_SET || ops[i].kind == OP_CLAMP) return true;
+    }
+    return false;
+}
+
+int64_t counter_apply_ops(const CounterOp* ops, size_t count, int64_t value) {
+    for (size_t i = 0; i < count; i++) value = apply_op(ops[i], value);
+    return value;
+}
+
+// set_epoch увеличивается до записи значения: отмена, прочитавшая старую
+// эпоху, либо проиграет CAS, либо будет перезаписана этим set.
+static CounterResult apply_batch(SharedSegment* seg, Mutex* mutex, const CounterOp* ops, size_t count,
+                                 uint64_t required_epoch) {
+    SharedCounter& sc = seg->counter;
+    CounterResult result = { 0, 0, false };
+    bool resets = resets_value(ops, count);
+    
+    if (!sc.sharded) {
+        // Эпоха увеличивается один раз до цикла CAS и только если она еще
+        // та, что прочитана: повтор CAS не порождает лишних эпох, а пачка с
+        // required_epoch после своего увеличения сверяется уже с новой.
+        if (resets) {
+            uint64_t epoch = sc.set_epoch.load();
+            bool bumped = (required_epoch == COUNTER_ANY_EPOCH || epoch == required_epoch) &&
+                          sc.set_epoch.compare_exchange_strong(epoch, epoch + 1);
+            if (bumped && required_epoch != COUNTER_ANY_EPOCH) required_epoch = epoch + 1;
+        }
+        
+        int64_t current = sc.value.load();
+        while (true) {
+            if (required_epoch != COUNTER_ANY_EPOCH && sc.set_epoch.load() != required_epoch) {
+                result.before = result.after = current;
+                return result;
+            }
+            int64_t next = counter_apply_ops(ops, count, current);
+            if (sc.value.compare_exchange_weak(current, next)) {
+                result.before = current;
+                result.after = next;
+                result.applied = true;
+                return result;
+            }
+        }
+    }
+    
+    mutex->lock();
+    if (required_epoch != COUNTER_ANY_EPOCH && sc.set_epoch.load() != required_epoch) {
+        mutex->unlock();
+        result.before = result.after = counter_read(seg);
+        return result;
+    }
+    if (resets) sc.set_epoch.fetch_add(1);
+    sc.shard_epoch.fetch_add(1);
+    // Шарды не обнуляются: новая база = результат - сумма шардов, и
+    // единственная запись value переводит счетчик из старого состояния в
+    // новое. Процесс, умерший внутри свертки, оставляет одно из двух, а
+    // Mutex::lock по EOWNERDEAD только возвращает эпоху к четной.
+    uint64_t shards = (uint64_t)sum_shards(seg);
+    result.before = (int64_t)((uint64_t)sc.value.load() + shards);
+    result.after = counter_apply_ops(ops, count, result.before);
+    sc.value.store((int64_t)((uint64_t)result.after - shards));
+    sc.shard_epoch.fetch_add(1);
+    mutex->unlock();
+    
+    result.applied = true;
+    return result;
+}
+
+CounterResult counter_apply(SharedSegment* seg, Mutex* mutex, const CounterOp* ops, size_t count,
+                            uint64_t required_epoch) {
+    trace_begin(TRACE_APPLY, count > 0 ? ops[0].kind : 0);
+    CounterResult result = apply_batch(seg, mutex, ops, count, required_epoch);
+    trace_end(TRACE_APPLY, result.after);
+    return result;
+}
+
+void counter_set(SharedSegment* seg, Mutex* mutex, int64_t value) {
+    CounterOp op = counter_op(OP_SET, value);
+    trace_begin(TRACE_SET, value);
+    counter_apply(seg, mutex, &op, 1);
+    trace_end(TRACE_SET, value);
+}
+
+ScopedTransform::ScopedTransform(SharedSegment* seg, Mutex* mutex, const CounterOp* ops, size_t count)
+    : seg(seg), mutex(mutex), active(true) {
+    CounterResult result;
+    do {
+        epoch = seg->counter.set_epoch.load();
+        result = counter_apply(seg, mutex, ops, count, epoch);
+    } while (!result.applied);
+    delta = result.after - result.before;
+    applied_value = result.after;
+}
+
+ScopedTransform::~ScopedTransform() {
+    revert();
+}
+
+int64_t ScopedTransform::value() const {
+    return applied_value;
+}
+
+bool ScopedTransform::revert() {
+    if (!active) return false;
+    active = false;
+    
+    CounterOp undo = counter_op(OP_ADD, -delta);
+    return counter_apply(seg, mutex, &undo, 1, epoch).applied;
+}
@@ -0,0 +1,117 @@
+#ifndef COUNTER_H
+#define COUNTER_H
+
+#include "platform.h"
+
+// Операции над общим счетчиком. В обычном режиме значение хранится в
+// SharedCounter::value. В шардированном (COUNTER_SHARDED=1 у процесса,
+// создавшего сегмент) value - это база, а инкременты идут в шард текущего
+// CPU; значение = база + сумма шардов. Остальные операции сворачивают
+// шарды в базу под мьютексом, увеличивая shard_epoch (нечетная эпоха -
+// свертка в процессе), а читатели повторяют чтение, если эпоха изменилась.
+// Свертка меняет только базу, одной записью, поэтому смерть процесса
+// посреди нее не теряет инкременты.
+//
+// Все операции, кроме counter_add, проходят через counter_apply: пачка
+// CounterOp применяется к значению одним CAS (в шардированном режиме -
+// одной сверткой под мьютексом), поэтому новой операции достаточно
+// добавить case в apply_op. Пачка с SET или CLAMP увеличивает set_epoch:
+// после нее отмена ScopedTransform не выполняется.
+
+enum CounterOpKind {
+    OP_ADD,
+    OP_MUL,
+    OP_DIV,
+    OP_SET,
+    OP_CLAMP
+};
+
+struct CounterOp {
+    CounterOpKind kind;
+    int64_t a;
+    int64_t b;
+};
+
+inline CounterOp counter_op(CounterOpKind kind, int64_t a, int64_t b = 0) {
+    CounterOp op = { kind, a, b };
+    return op;
+}
+
+struct CounterResult {
+    int64_t before;
+    int64_t after;
+    bool applied;
+};
+
+#define COUNTER_ANY_EPOCH UINT64_MAX
+
+// Согласованный снимок SharedCounter без блокировок и системных вызовов.
+// Если запись не завершилась за COUNTER_SNAPSHOT_RETRIES попыток (писатель
+// умер или завис), поля возвращаются как есть и consistent == false.
+#define COUNTER_SNAPSHOT_RETRIES 1000
+
+struct CounterSnapshot {
+    int64_t value;
+    platform_pid_t leader_pid;
+    time_t last_leader_activity;
+    bool consistent;
+};
+
+int64_t counter_read(SharedSegment* seg);
+void counter_snapshot(SharedSegment* seg, CounterSnapshot* out);
+void counter_add(SharedSegment* seg, int64_t delta);
+void counter_set(SharedSegment* seg, Mutex* mutex, int64_t value);
+
+// Высокочастотный режим. counter_increment копит n в слоте потока
+// (DeltaTable) без общих атомарных операций и переносит накопленное в
+// счетчик одним counter_add, когда |дельта| достигает
+// COUNTER_DELTA_THRESHOLD (4096). Остаток переносит фоновый поток процесса
+// каждые COUNTER_DELTA_FLUSH_MS (10) мс, так что counter_read - быстрое
+// приближенное значение, отстающее не больше чем на этот интервал, а
+// counter_read_exact сначала переносит дельты всех процессов группы.
+void counter_increment(SharedSegment* seg, int64_t n = 1);
+int64_t counter_read_exact(SharedSegment* seg);
+// Останавливает фоновый перенос, переносит дельты процесса и освобождает
+// его слоты; вызывается до отключения от сегмента.
+void counter_deltas_shutdown(SharedSegment* seg);
+
+struct DeltaSummary {
+    uint64_t calls;
+    uint64_t flushes;
+    int64_t pending;
+    int slots;
+    uint64_t staleness_p50;
+    uint64_t staleness_p99;
+    uint64_t staleness_max;
+};
+
+void counter_delta_summary(SharedSegment* seg, DeltaSummary* out);
+
+int64_t counter_apply_ops(const CounterOp* ops, size_t count, int64_t value);
+// Если required_epoch задан и set_epoch уже другой, ничего не меняет и
+// возвращает applied=false.
+CounterResult counter_apply(SharedSegment* seg, Mutex* mutex, const CounterOp* ops, size_t count,
+                            uint64_t required_epoch = COUNTER_ANY_EPOCH);
+
+// Обратимое преобразование на время жизни объекта: запоминает, на сколько
+// изменилось значение, и при отмене вычитает ровно эту величину, так что
+// инкременты других процессов в промежутке сохраняются без округления.
+class ScopedTransform {
+public:
+    ScopedTransform(SharedSegment* seg, Mutex* mutex, const CounterOp* ops, size_t count);
+    ~ScopedTransform();
+    
+    int64_t value() const;
+    // false, если значение было установлено заново и отмена пропущена.
+    bool revert();
+    
+private:
+    SharedSegment* seg;
+    Mutex* mutex;
+    int64_t delta;
+    uint64_t epoch;
+    bool active;
+    int64_t applied_value;
+};
+
+#endif
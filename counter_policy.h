@@ -0,0 +1,166 @@
+#ifndef COUNTER_POLICY_H
+#define COUNTER_POLICY_H
+
+#include "platform.h"
+#include "logger.h"
+#include "counter.h"
+#include "persist.h"
+
+// Счетчик со стратегиями, выбираемыми при компиляции:
+//
+//   Counter<LockPolicy, StoragePolicy, LogPolicy>
+//
+// Стратегии - переходники к существующим примитивам, а не свои реализации:
+//
+// LockPolicy    - AtomicLock (counter_add без блокировки), MutexLock
+//                 (counter_add под робастным Mutex группы: futex в Linux,
+//                 семафор в Windows)
+// StoragePolicy - ShmStorage (сегмент SharedMemory), FileStorage (он же,
+//                 плюс контрольные точки COUNTER_PERSIST из persist.h:
+//                 новый сегмент начинает с сохраненного значения)
+// LogPolicy     - NullLog, SyncLog (log_set_sync: каждая запись - write
+//                 из пишущего процесса), AsyncLog (собственный AsyncLogger
+//                 процесса), RingLog (LogRing сегмента, файл пишет лидер)
+//
+// Виртуальных вызовов нет: каждая комбинация - отдельный тип. main.cpp
+// собирается с COUNTER_POLICY_LOCK/STORAGE/LOG (по умолчанию
+// AtomicLock/FileStorage/RingLog); все комбинации - цель make variants,
+// сравнение скорости - counter_bench policy.
+
+// ---- Блокировки ----
+
+struct AtomicLock {
+    static const char* name() { return "atomic"; }
+    
+    static void add(SharedSegment* seg, Mutex*, int64_t delta) {
+        counter_add(seg, delta);
+    }
+};
+
+struct MutexLock {
+    static const char* name() { return "mutex"; }
+    
+    static void add(SharedSegment* seg, Mutex* mutex, int64_t delta) {
+        mutex->lock();
+        counter_add(seg, delta);
+        mutex->unlock();
+    }
+};
+
+// ---- Хранилища ----
+// on_create передается в SharedMemory; start_checkpoints вызывает процесс,
+// отвечающий за сохранение (в main - лидер).
+
+struct ShmStorage {
+    static const char* name() { return "shm"; }
+    static void on_create(SharedSegment*) {}
+    static bool restored(CheckpointRecord*) { return false; }
+    static Checkpointer* start_checkpoints(SharedSegment*) { return nullptr; }
+};
+
+struct FileStorage {
+    static const char* name() { return "file"; }
+    
+    static void on_create(SharedSegment* seg) {
+        Restored& state = restored_state();
+        state.valid = checkpoint_recover(&state.record);
+        if (state.valid) seg->counter.value.store(state.record.value);
+    }
+    
+    // Восстановленная этим процессом запись - для лога после подключения
+    // к кольцу.
+    static bool restored(CheckpointRecord* out) {
+        if (restored_state().valid) *out = restored_state().record;
+        return restored_state().valid;
+    }
+    
+    static Checkpointer* start_checkpoints(SharedSegment* seg) {
+        if (!checkpoint_path()) return nullptr;
+        return new Checkpointer(seg, checkpoint_path(), env_int("COUNTER_PERSIST_MS", 1000));
+    }
+
+private:
+    struct Restored {
+        bool valid;
+        CheckpointRecord record;
+    };
+    
+    static Restored& restored_state() {
+        static Restored state = {};
+        return state;
+    }
+};
+
+// ---- Логирование ----
+// attach вызывается один раз после подключения к сегменту и определяет,
+// куда идут все записи процесса; record - запись об операции счетчика.
+
+struct NullLog {
+    static const char* name() { return "none"; }
+    static void attach(SharedSegment*) {}
+    static void record(LogEventType, int64_t) {}
+};
+
+struct SyncLog {
+    static const char* name() { return "sync"; }
+    static void attach(SharedSegment*) { log_set_sync(true); }
+    static void record(LogEventType type, int64_t value) { log_event(type, ROLE_NONE, value); }
+};
+
+struct AsyncLog {
+    static const char* name() { return "async"; }
+    static void attach(SharedSegment*) {}
+    static void record(LogEventType type, int64_t value) { log_event(type, ROLE_NONE, value); }
+};
+
+struct RingLog {
+    static const char* name() { return "ring"; }
+    static void attach(SharedSegment* seg) { log_attach_ring(&seg->log_ring); }
+    static void record(LogEventType type, int64_t value) { log_event(type, ROLE_NONE, value); }
+};
+
+// ---- Счетчик ----
+// Владеет подключением к сегменту и Mutex группы. add пишет в лог, только
+// если log_adds: main увеличивает счетчик по таймеру и пишет его значение
+// раз в секунду, бенчмарк измеряет запись каждой операции.
+
+template <class LockPolicy, class StoragePolicy, class LogPolicy>
+class Counter {
+public:
+    typedef StoragePolicy Storage;
+    
+    explicit Counter(const char* name = SHM_NAME, bool log_adds = false)
+        : shared(name, StoragePolicy::on_create), group_mutex(&shared), log_adds(log_adds) {
+        LogPolicy::attach(shared.segment());
+    }
+    
+    void add(int64_t delta) {
+        LockPolicy::add(shared.segment(), &group_mutex, delta);
+        if (log_adds) LogPolicy::record(LOG_EV_COUNTER, get());
+    }
+    
+    void set(int64_t value) {
+        counter_set(shared.segment(), &group_mutex, value);
+        LogPolicy::record(LOG_EV_MANUAL_SET, value);
+    }
+    
+    int64_t get() {
+        return counter_read(shared.segment());
+    }
+    
+    SharedMemory& memory() { return shared; }
+    SharedSegment* segment() { return shared.segment(); }
+    Mutex& mutex() { return group_mutex; }
+    
+    // "mutex/shm/async" - для таблиц бенчмарка.
+    static std::string describe() {
+        return std::string(LockPolicy::name()) + "/" + StoragePolicy::name() + "/" + LogPolicy::name();
+    }
+
+private:
+    SharedMemory shared;
+    Mutex group_mutex;
+    bool log_adds;
+};
+
+#endif
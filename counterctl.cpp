@@ -0,0 +1,190 @@
+// Клиент управляющего сокета лидера (см. control.h).
+// Сборка: g++ -O2 -std=c++17 counterctl.cpp -o counterctl
+//
+//   counterctl [-s СОКЕТ] КОМАНДА [АРГУМЕНТЫ]  - одна команда, печатает ответ
+//   counterctl [-s СОКЕТ]                      - команды построчно из stdin
+//   counterctl [-s СОКЕТ] --bench N [--depth D] - N команд "ADD 1" пачками по D
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <chrono>
+#include <iostream>
+
+#ifdef __linux__
+    #include <unistd.h>
+    #include <errno.h>
+    #include <poll.h>
+    #include <sys/socket.h>
+    #include <sys/un.h>
+    #include <cstddef>
+#endif
+
+#ifdef __linux__
+static int connect_control(const char* name) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    
+    bool abstract = name[0] == '@';
+    const char* path = abstract ? name + 1 : name;
+    size_t length = strlen(path);
+    if (length + 1 > sizeof(addr.sun_path)) length = sizeof(addr.sun_path) - 1;
+    memcpy(addr.sun_path + (abstract ? 1 : 0), path, length);
+    socklen_t addr_len = (socklen_t)(offsetof(struct sockaddr_un, sun_path) + length + (abstract ? 1 : 0));
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr*)&addr, addr_len) == -1) {
+        fprintf(stderr, "Не удалось подключиться к %s: %s\n", name, strerror(errno));
+        exit(1);
+    }
+    return fd;
+}
+
+static void write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("send");
+            exit(1);
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+}
+
+// Читает ответы, пока не получено lines строк (или до EOF при lines < 0),
+// и печатает их, если print.
+static long read_replies(int fd, std::string& buffer, long lines, bool print) {
+    long seen = 0;
+    char chunk[65536];
+    
+    while (lines < 0 || seen < lines) {
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        
+        buffer.append(chunk, (size_t)n);
+        size_t start = 0, end;
+        while ((end = buffer.find('\n', start)) != std::string::npos) {
+            if (print) fwrite(buffer.data() + start, 1, end - start + 1, stdout);
+            start = end + 1;
+            seen++;
+        }
+        buffer.erase(0, start);
+    }
+    return seen;
+}
+
+// Команды из stdin отправляются без ожидания ответов; ответы читаются
+// параллельно через poll, чтобы ни одна сторона не переполнила буфер.
+static int run_stdin(int fd) {
+    std::string out, in;
+    bool input_done = false;
+    char chunk[65536];
+    
+    while (true) {
+        struct pollfd fds[2] = {
+            { fd, (short)(POLLIN | (out.empty() ? 0 : POLLOUT)), 0 },
+            { STDIN_FILENO, (short)(input_done || out.size() > (1 << 20) ? 0 : POLLIN), 0 },
+        };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            return 1;
+        }
+        
+        if (fds[1].revents) {
+            ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+            if (n <= 0) {
+                input_done = true;
+            } else {
+                out.append(chunk, (size_t)n);
+            }
+        }
+        
+        if ((fds[0].revents & POLLOUT) && !out.empty()) {
+            ssize_t n = send(fd, out.data(), out.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) out.erase(0, (size_t)n);
+        }
+        if (input_done && out.empty()) {
+            shutdown(fd, SHUT_WR);
+            break;
+        }
+        
+        if (fds[0].revents & (POLLIN | POLLHUP)) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n <= 0) return 0;
+            fwrite(chunk, 1, (size_t)n, stdout);
+        }
+    }
+    
+    read_replies(fd, in, -1, true);
+    return 0;
+}
+
+static int run_bench(int fd, long total, long depth) {
+    std::string batch;
+    for (long i = 0; i < depth; i++) batch += "ADD 1\n";
+    
+    std::string buffer;
+    auto start = std::chrono::steady_clock::now();
+    long done = 0;
+    while (done < total) {
+        long count = total - done < depth ? total - done : depth;
+        write_all(fd, batch.data(), (size_t)count * 6);
+        if (read_replies(fd, buffer, count, false) != count) {
+            fprintf(stderr, "Соединение закрыто сервером\n");
+            return 1;
+        }
+        done += count;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    
+    printf("%ld команд, глубина конвейера %ld: %.3f с, %.0f команд/с\n",
+           total, depth, seconds, total / seconds);
+    return 0;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+#ifndef __linux__
+    std::cout << "counterctl: управляющий сокет поддерживается только в Linux\n";
+    return 1;
+#else
+    const char* name = getenv("COUNTER_CONTROL");
+    if (!name || !*name) name = "@counter_control";
+    
+    long bench = 0;
+    long depth = 64;
+    std::string command;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-s" && has_value) name = argv[++i];
+        else if (arg == "--bench" && has_value) bench = atol(argv[++i]);
+        else if (arg == "--depth" && has_value) depth = atol(argv[++i]);
+        else command += (command.empty() ? "" : " ") + arg;
+    }
+    
+    int fd = connect_control(name);
+    int rc = 0;
+    
+    if (bench > 0) {
+        rc = run_bench(fd, bench, depth > 0 ? depth : 1);
+    } else if (!command.empty()) {
+        command += "\n";
+        write_all(fd, command.data(), command.size());
+        std::string buffer;
+        rc = read_replies(fd, buffer, 1, true) == 1 ? 0 : 1;
+    } else {
+        rc = run_stdin(fd);
+    }
+    
+    close(fd);
+    return rc;
+#endif
+}
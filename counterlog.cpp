@@ -0,0 +1,302 @@
+// Запросы к двоичному логу (COUNTER_LOG_FORMAT=binary) без его разбора:
+// сегменты отображаются в память как массивы LogEvent.
+// Линкуется только с кодом формата лога. Сборка:
+// g++ -O3 -std=c++17 counterlog.cpp log_events.cpp log_segments.cpp timestamp.cpp -pthread -o counterlog
+//
+//   counterlog [УСЛОВИЯ] [ФАЙЛ...]           - найденные события в текстовом формате лога
+//   counterlog [УСЛОВИЯ] --count [ФАЙЛ...]   - число событий по типам
+//   counterlog [УСЛОВИЯ] --stats [ФАЙЛ...]   - min/max значения и интервал времени
+//
+// УСЛОВИЯ: --from T, --to T (T - "ГГГГ-ММ-ДД чч:мм:сс[.ммм]" или секунды от
+// эпохи), --pid N, --type ИМЯ (counter, start, end, exit, ...), --min V,
+// --max V (по полю value), --scan (без поиска границ по времени, см.
+// time_range). Без файлов читаются закрытые сегменты и активный файл
+// log_binary_filename().
+#include "platform.h"
+#include "log_segments.h"
+#include "log_events.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+
+// Записи упорядочены по времени лишь приблизительно: метка ставится до
+// резервирования слота в общем кольце, а файл пишется в порядке слотов.
+// Поиск границ считает, что более поздняя запись не старше более ранней
+// больше чем на TIME_SLACK_NS (вытеснение процесса между меткой и
+// резервированием дольше секунды, перевод часов назад). Если это не так,
+// --scan проверяет все записи.
+#define TIME_SLACK_NS 1000000000ULL
+#define SCAN_CHUNK 4096
+
+struct Query {
+    uint64_t from;
+    uint64_t to;
+    int64_t min;
+    int64_t max;
+    int32_t pid;
+    int type;
+    bool scan;
+};
+
+struct MappedLog {
+    std::string path;
+    const LogEvent* events;
+    size_t count;
+    size_t bytes;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+};
+
+struct QueryTotals {
+    uint64_t matched;
+    uint64_t by_type[LOG_EV_TYPES];
+    int64_t min_value;
+    int64_t max_value;
+    uint64_t first_ns;
+    uint64_t last_ns;
+};
+
+static bool map_log(const std::string& path, MappedLog* log) {
+    log->path = path;
+    log->events = nullptr;
+    log->count = 0;
+    log->bytes = 0;
+#ifdef _WIN32
+    log->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (log->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(log->file, &size) || size.QuadPart < (LONGLONG)sizeof(LogEvent)) {
+        CloseHandle(log->file);
+        return size.QuadPart == 0;
+    }
+    log->bytes = (size_t)size.QuadPart;
+    log->mapping = CreateFileMappingA(log->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void* ptr = log->mapping ? MapViewOfFile(log->mapping, FILE_MAP_READ, 0, 0, log->bytes) : nullptr;
+    if (!ptr) {
+        fprintf(stderr, "Ошибка отображения %s: %lu\n", path.c_str(), GetLastError());
+        return false;
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+    struct stat st;
+    fstat(fd, &st);
+    log->bytes = (size_t)st.st_size;
+    if (log->bytes < sizeof(LogEvent)) {
+        close(fd);
+        return true;
+    }
+    const void* ptr = mmap(NULL, log->bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        perror("mmap");
+        return false;
+    }
+    madvise((void*)ptr, log->bytes, MADV_SEQUENTIAL);
+#endif
+    log->events = (const LogEvent*)ptr;
+    // Хвост неполной записи (файл дописывается) не читается.
+    log->count = log->bytes / sizeof(LogEvent);
+    return true;
+}
+
+static void unmap_log(MappedLog* log) {
+    if (!log->events) return;
+#ifdef _WIN32
+    UnmapViewOfFile(log->events);
+    CloseHandle(log->mapping);
+    CloseHandle(log->file);
+#else
+    munmap((void*)log->events, log->bytes);
+#endif
+}
+
+// Первая запись, начиная с которой метки больше ts: двоичный поиск прямо
+// по отображенному файлу, O(log n) страниц на запрос, поэтому индекс не
+// строится и не хранится.
+static size_t first_after(const MappedLog& log, uint64_t ts) {
+    size_t low = 0, high = log.count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (log.events[mid].ts_ns > ts) high = mid;
+        else low = mid + 1;
+    }
+    return low;
+}
+
+// Диапазон записей [*begin, *end), где могут быть события из [from, to].
+// При отклонении порядка не больше TIME_SLACK_NS все записи до найденной
+// границы "> from - запас" старше from, а после "> to + запас" - новее to.
+static void time_range(const MappedLog& log, const Query& q, size_t* begin, size_t* end) {
+    *begin = 0;
+    *end = log.count;
+    if (q.scan) return;
+    
+    if (q.from > TIME_SLACK_NS) *begin = first_after(log, q.from - TIME_SLACK_NS - 1);
+    if (q.to < UINT64_MAX - TIME_SLACK_NS) *end = first_after(log, q.to + TIME_SLACK_NS);
+    if (*end < *begin) *end = *begin;
+}
+
+// Проверка условий без ветвлений: результат суммируется в счетчики и
+// индексы совпавших записей, поэтому цикл не зависит от предсказания
+// переходов и векторизуется компилятором при -O3.
+static size_t scan_chunk(const LogEvent* events, size_t count, const Query& q, uint32_t* matched) {
+    size_t found = 0;
+    bool any_pid = q.pid == 0;
+    bool any_type = q.type == LOG_EV_NONE;
+    for (size_t i = 0; i < count; i++) {
+        const LogEvent& e = events[i];
+        bool ok = (e.ts_ns >= q.from) & (e.ts_ns <= q.to) &
+                  (e.value >= q.min) & (e.value <= q.max) &
+                  (any_pid | (e.pid == q.pid)) & (any_type | (e.type == q.type));
+        matched[found] = (uint32_t)i;
+        found += ok;
+    }
+    return found;
+}
+
+static void query_log(const MappedLog& log, const Query& q, bool print, QueryTotals* totals) {
+    size_t begin, end;
+    time_range(log, q, &begin, &end);
+    
+    std::vector<uint32_t> matched(SCAN_CHUNK);
+    char ts[TIMESTAMP_SIZE];
+    char line[512];
+    
+    for (size_t chunk = begin; chunk < end; chunk += SCAN_CHUNK) {
+        size_t count = std::min((size_t)SCAN_CHUNK, end - chunk);
+        const LogEvent* events = log.events + chunk;
+        size_t found = scan_chunk(events, count, q, matched.data());
+        
+        for (size_t k = 0; k < found; k++) {
+            const LogEvent& e = events[matched[k]];
+            totals->matched++;
+            totals->by_type[e.type < LOG_EV_TYPES ? (int)e.type : (int)LOG_EV_NONE]++;
+            totals->min_value = std::min(totals->min_value, e.value);
+            totals->max_value = std::max(totals->max_value, e.value);
+            totals->first_ns = std::min(totals->first_ns, e.ts_ns);
+            totals->last_ns = std::max(totals->last_ns, e.ts_ns);
+            
+            if (print) {
+                format_timestamp_ns(e.ts_ns, ts, sizeof(ts));
+                size_t length = log_event_format(e, ts, line, sizeof(line) - 1);
+                line[length++] = '\n';
+                fwrite(line, 1, length, stdout);
+            }
+        }
+    }
+}
+
+// "ГГГГ-ММ-ДД чч:мм:сс[.ммм]" в местном времени или секунды от эпохи.
+static bool parse_time(const char* text, uint64_t* ns) {
+    int year, month, day, hour = 0, minute = 0, second = 0, ms = 0;
+    if (sscanf(text, "%d-%d-%d %d:%d:%d.%d", &year, &month, &day, &hour, &minute, &second, &ms) >= 3) {
+        struct tm local;
+        memset(&local, 0, sizeof(local));
+        local.tm_year = year - 1900;
+        local.tm_mon = month - 1;
+        local.tm_mday = day;
+        local.tm_hour = hour;
+        local.tm_min = minute;
+        local.tm_sec = second;
+        local.tm_isdst = -1;
+        time_t sec = mktime(&local);
+        if (sec == (time_t)-1) return false;
+        *ns = (uint64_t)sec * 1000000000ULL + (uint64_t)ms * 1000000ULL;
+        return true;
+    }
+    
+    char* end;
+    double seconds = strtod(text, &end);
+    if (end == text || *end != '\0' || seconds < 0) return false;
+    *ns = (uint64_t)(seconds * 1e9);
+    return true;
+}
+
+static int usage() {
+    fprintf(stderr,
+            "Использование: counterlog [--from T] [--to T] [--pid N] [--type ИМЯ] [--min V] [--max V]\n"
+            "                          [--scan] [--count | --stats] [ФАЙЛ...]\n");
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    Query q = { 0, UINT64_MAX, INT64_MIN, INT64_MAX, 0, LOG_EV_NONE, false };
+    std::string mode = "export";
+    std::vector<std::string> files;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--from" && has_value) {
+            if (!parse_time(argv[++i], &q.from)) return usage();
+        } else if (arg == "--to" && has_value) {
+            if (!parse_time(argv[++i], &q.to)) return usage();
+        } else if (arg == "--pid" && has_value) {
+            q.pid = atoi(argv[++i]);
+        } else if (arg == "--type" && has_value) {
+            q.type = log_event_type_from_name(argv[++i]);
+            if (q.type == LOG_EV_NONE) {
+                fprintf(stderr, "Неизвестный тип события: %s\n", argv[i]);
+                return 1;
+            }
+        } else if (arg == "--min" && has_value) {
+            q.min = atoll(argv[++i]);
+        } else if (arg == "--max" && has_value) {
+            q.max = atoll(argv[++i]);
+        } else if (arg == "--scan") {
+            q.scan = true;
+        } else if (arg == "--count" || arg == "--stats") {
+            mode = arg.substr(2);
+        } else if (arg.compare(0, 2, "--") == 0) {
+            return usage();
+        } else {
+            files.push_back(arg);
+        }
+    }
+    
+    if (files.empty()) {
+        files = log_segment_files(log_binary_filename());
+        files.push_back(log_binary_filename());
+    }
+    
+    QueryTotals totals;
+    memset(&totals, 0, sizeof(totals));
+    totals.min_value = INT64_MAX;
+    totals.max_value = INT64_MIN;
+    totals.first_ns = UINT64_MAX;
+    uint64_t scanned = 0;
+    
+    for (const std::string& path : files) {
+        MappedLog log;
+        if (!map_log(path, &log)) {
+            fprintf(stderr, "Не удалось открыть %s\n", path.c_str());
+            continue;
+        }
+        scanned += log.count;
+        query_log(log, q, mode == "export", &totals);
+        unmap_log(&log);
+    }
+    
+    if (mode == "count") {
+        for (int type = LOG_EV_NONE + 1; type < LOG_EV_TYPES; type++) {
+            if (totals.by_type[type] > 0) {
+                printf("%-16s %llu\n", log_event_type_name(type), (unsigned long long)totals.by_type[type]);
+            }
+        }
+        printf("всего: %llu из %llu\n", (unsigned long long)totals.matched, (unsigned long long)scanned);
+    } else if (mode == "stats") {
+        printf("событий     %llu из %llu\n", (unsigned long long)totals.matched, (unsigned long long)scanned);
+        if (totals.matched > 0) {
+            char first[TIMESTAMP_SIZE], last[TIMESTAMP_SIZE];
+            format_timestamp_ns(totals.first_ns, first, sizeof(first));
+            format_timestamp_ns(totals.last_ns, last, sizeof(last));
+            printf("value       %lld .. %lld\n", (long long)totals.min_value, (long long)totals.max_value);
+            printf("время       %s .. %s\n", first, last);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,337 @@
+// Просмотр состояния группы без участия в ней: сегмент отображается только
+// для чтения, поэтому наблюдение не меняет счетчик и не берет блокировок.
+// Зависит только от раскладки сегмента (segment.h), с остальным кодом не
+// линкуется. Сборка: g++ -O2 -std=c++17 counterstat.cpp -o counterstat
+//
+//   counterstat                 - текущее состояние и счетчики событий
+//   counterstat --watch С       - то же каждые С секунд, со скоростями
+//   counterstat --prometheus    - текстовый формат Prometheus в stdout
+//   counterstat --serve ПОРТ    - HTTP на 127.0.0.1:ПОРТ для сбора Prometheus
+#include "segment.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+
+#ifndef _WIN32
+    #include <unistd.h>
+    #include <fcntl.h>
+    #include <errno.h>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+#endif
+
+struct MetricValue {
+    const char* name;
+    const char* help;
+    uint64_t value;
+};
+
+#define METRIC_COUNT 16
+
+struct RoleSample {
+    uint64_t exits;
+    int32_t last_exit_status;
+    int64_t last_runtime_ms;
+};
+
+// Поля, которые пишутся под seqlock (state_seq, shard_epoch), читаются
+// повторно, пока запись не завершится, но не больше READ_RETRIES раз:
+// писатель мог умереть посреди записи. Тогда поля выводятся как есть с
+// пометкой о несогласованности.
+#define READ_RETRIES 1000
+
+struct CounterSample {
+    int64_t value;
+    int64_t leader_pid;
+    time_t last_leader_activity;
+    bool value_consistent;
+    bool leader_consistent;
+};
+
+struct MetricsSample {
+    CounterSample snap;
+    uint64_t leader_epoch;
+    uint64_t participants;
+    RoleSample roles[ROLE_COUNT];
+    MetricValue values[METRIC_COUNT];
+};
+
+static const SharedSegment* map_segment_readonly() {
+#ifdef _WIN32
+    HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, SHM_NAME);
+    if (handle == NULL) {
+        fprintf(stderr, "Сегмент %s не найден: счетчик не запущен\n", SHM_NAME);
+        exit(1);
+    }
+    const void* ptr = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, sizeof(SharedSegment));
+    if (!ptr) {
+        fprintf(stderr, "Ошибка отображения памяти: %lu\n", GetLastError());
+        exit(1);
+    }
+#else
+    int fd = shm_open(SHM_NAME, O_RDONLY, 0);
+    if (fd == -1) {
+        fprintf(stderr, "Сегмент %s не найден: счетчик не запущен\n", SHM_NAME);
+        exit(1);
+    }
+    const void* ptr = mmap(NULL, sizeof(SharedSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ptr == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+#endif
+    return (const SharedSegment*)ptr;
+}
+
+// Значение: в шардированном режиме - база плюс сумма шардов под эпохой
+// свертки (см. counter.h).
+static int64_t read_value(const SharedCounter& sc, const CounterShard* shards, bool* consistent) {
+    *consistent = true;
+    if (!sc.sharded) return sc.value.load();
+    
+    int64_t value = 0;
+    for (int attempt = 0; attempt < READ_RETRIES; attempt++) {
+        uint64_t epoch = sc.shard_epoch.load(std::memory_order_acquire);
+        uint64_t sum = (uint64_t)sc.value.load(std::memory_order_acquire);
+        for (int i = 0; i < COUNTER_SHARDS; i++) {
+            sum += (uint64_t)shards[i].delta.load(std::memory_order_relaxed);
+        }
+        value = (int64_t)sum;
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!(epoch & 1) && sc.shard_epoch.load(std::memory_order_relaxed) == epoch) return value;
+        std::this_thread::yield();
+    }
+    *consistent = false;
+    return value;
+}
+
+static void read_counter(const SharedSegment* seg, CounterSample* out) {
+    const SharedCounter& sc = seg->counter;
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    
+    out->leader_consistent = false;
+    for (int attempt = 0; attempt < READ_RETRIES && !out->leader_consistent; attempt++) {
+        uint64_t seq = sc.state_seq.load(std::memory_order_acquire);
+        out->leader_pid = (int64_t)sc.leader_pid.load(relaxed);
+        out->last_leader_activity = sc.last_leader_activity.load(relaxed);
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        out->leader_consistent = !(seq & 1) && sc.state_seq.load(relaxed) == seq;
+        if (!out->leader_consistent) std::this_thread::yield();
+    }
+    out->value = read_value(sc, seg->shards, &out->value_consistent);
+}
+
+static void take_sample(const SharedSegment* seg, MetricsSample* sample) {
+    read_counter(seg, &sample->snap);
+    sample->leader_epoch = seg->lease.epoch.load(std::memory_order_relaxed);
+    
+    const MetricsPage& m = seg->metrics;
+    const std::memory_order relaxed = std::memory_order_relaxed;
+    uint64_t delta_calls = 0;
+    for (int i = 0; i < DELTA_SLOTS; i++) delta_calls += seg->deltas.slots[i].calls.load(relaxed);
+    
+    const ParticipantTable& table = seg->participants;
+    sample->participants = 0;
+    for (int i = 0; i < PARTICIPANT_SLOTS; i++) {
+        if (table.slots[i].pid.load(relaxed) > 0) sample->participants++;
+    }
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        sample->roles[role].exits = table.roles[role].exits.load(relaxed);
+        sample->roles[role].last_exit_status = table.roles[role].last_exit_status.load(relaxed);
+        sample->roles[role].last_runtime_ms = table.roles[role].last_runtime_ms.load(relaxed);
+    }
+    MetricValue values[METRIC_COUNT] = {
+        { "increments", "Инкременты счетчика", m.increments.load(relaxed) },
+        { "sets", "Установки значения", m.sets.load(relaxed) },
+        { "spawns", "Запуски заданий child1/child2", m.spawns.load(relaxed) },
+        { "spawn_skips", "Пропуски запуска: задание еще выполняется", m.spawn_skips.load(relaxed) },
+        { "child_exits", "Завершения дочерних процессов", m.child_exits.load(relaxed) },
+        { "child_failures", "Завершения с ненулевым кодом", m.child_failures.load(relaxed) },
+        { "log_lines", "Строки, поставленные в общий лог", seg->log_ring.head.load(relaxed) },
+        { "log_dropped", "Строки, потерянные при переполнении лога", seg->log_ring.overflow.load(relaxed) },
+        { "lock_waits", "Захваты мьютекса с ожиданием", m.lock_waits.load(relaxed) },
+        { "lock_wait_ns", "Суммарное ожидание мьютекса, нс", m.lock_wait_ns.load(relaxed) },
+        { "control_requests", "Команды управляющего сокета", m.control_requests.load(relaxed) },
+        { "checkpoints", "Записанные контрольные точки", m.checkpoints.load(relaxed) },
+        { "leader_changes", "Смены лидера (эпоха аренды)", sample->leader_epoch },
+        { "shard_folds", "Свертки шардов", seg->counter.shard_epoch.load(relaxed) / 2 },
+        { "delta_increments", "Вызовы counter_increment", delta_calls },
+        { "delta_flushes", "Переносы накопленных дельт в счетчик", seg->deltas.flushes.load(relaxed) },
+    };
+    memcpy(sample->values, values, sizeof(values));
+}
+
+static void print_sample(const MetricsSample& now, const MetricsSample* before, double seconds) {
+    const CounterSample& snap = now.snap;
+    printf("value             %lld%s\n", (long long)snap.value,
+           snap.value_consistent ? "" : " (несогласовано: свертка шардов не завершена)");
+    printf("leader            PID %lld, активность %lld с назад%s\n",
+           (long long)snap.leader_pid, (long long)(time(nullptr) - snap.last_leader_activity),
+           snap.leader_consistent ? "" : " (несогласовано: запись не завершена)");
+    printf("participants      %llu\n", (unsigned long long)now.participants);
+    for (int role = ROLE_WORKER; role < ROLE_COUNT; role++) {
+        const RoleSample& stats = now.roles[role];
+        printf("%-17s завершений %llu, последний код %d, %lld мс\n",
+               participant_role_name(role), (unsigned long long)stats.exits,
+               stats.last_exit_status, (long long)stats.last_runtime_ms);
+    }
+    
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        printf("%-17s %llu", now.values[i].name, (unsigned long long)now.values[i].value);
+        if (before) {
+            printf("  (%.1f/с)", (double)(now.values[i].value - before->values[i].value) / seconds);
+        }
+        printf("\n");
+    }
+}
+
+static std::string prometheus_text(const MetricsSample& sample) {
+    std::string text;
+    char line[1024];
+    
+    snprintf(line, sizeof(line),
+             "# HELP counter_value Текущее значение общего счетчика\n"
+             "# TYPE counter_value gauge\ncounter_value %lld\n"
+             "# HELP counter_leader_pid PID текущего лидера\n"
+             "# TYPE counter_leader_pid gauge\ncounter_leader_pid %lld\n"
+             "# HELP counter_participants Занятые слоты таблицы участников\n"
+             "# TYPE counter_participants gauge\ncounter_participants %llu\n"
+             "# HELP counter_snapshot_consistent 1, если значение и лидер прочитаны согласованно\n"
+             "# TYPE counter_snapshot_consistent gauge\ncounter_snapshot_consistent %d\n",
+             (long long)sample.snap.value, (long long)sample.snap.leader_pid,
+             (unsigned long long)sample.participants,
+             sample.snap.value_consistent && sample.snap.leader_consistent ? 1 : 0);
+    text += line;
+    
+    for (int i = 0; i < METRIC_COUNT; i++) {
+        const MetricValue& metric = sample.values[i];
+        snprintf(line, sizeof(line),
+                 "# HELP counter_%s_total %s\n# TYPE counter_%s_total counter\ncounter_%s_total %llu\n",
+                 metric.name, metric.help, metric.name, metric.name, (unsigned long long)metric.value);
+        text += line;
+    }
+    
+    text += "# HELP counter_role_exits_total Завершения процессов по ролям\n"
+            "# TYPE counter_role_exits_total counter\n";
+    for (int role = ROLE_WORKER; role < ROLE_COUNT; role++) {
+        snprintf(line, sizeof(line), "counter_role_exits_total{role=\"%s\"} %llu\n",
+                 participant_role_name(role), (unsigned long long)sample.roles[role].exits);
+        text += line;
+    }
+    return text;
+}
+
+#ifndef _WIN32
+// Однопоточный HTTP-сервер: на любой запрос отдает текущие метрики и
+// закрывает соединение. Слушает только 127.0.0.1.
+static int serve_prometheus(const SharedSegment* seg, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    
+    if (fd == -1 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1 || listen(fd, 16) == -1) {
+        perror("bind/listen");
+        return 1;
+    }
+    printf("Метрики: http://127.0.0.1:%d/metrics\n", port);
+    fflush(stdout);
+    
+    while (true) {
+        int client = accept(fd, nullptr, nullptr);
+        if (client == -1) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            return 1;
+        }
+        
+        char request[1024];
+        ssize_t n = recv(client, request, sizeof(request), 0);
+        (void)n;
+        
+        MetricsSample sample;
+        take_sample(seg, &sample);
+        std::string body = prometheus_text(sample);
+        
+        char header[128];
+        int length = snprintf(header, sizeof(header),
+                              "HTTP/1.0 200 OK\r\n"
+                              "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                              "Content-Length: %zu\r\n\r\n",
+                              body.size());
+        std::string response(header, (size_t)length);
+        response += body;
+        
+        const char* data = response.data();
+        size_t left = response.size();
+        while (left > 0) {
+            ssize_t sent = send(client, data, left, MSG_NOSIGNAL);
+            if (sent <= 0) break;
+            data += sent;
+            left -= (size_t)sent;
+        }
+        close(client);
+    }
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    const SharedSegment* seg = map_segment_readonly();
+    
+    if (mode == "--prometheus") {
+        MetricsSample sample;
+        take_sample(seg, &sample);
+        std::cout << prometheus_text(sample);
+        return 0;
+    }
+    
+    if (mode == "--serve" && argc > 2) {
+#ifdef _WIN32
+        std::cout << "--serve: требуются POSIX-сокеты\n";
+        return 1;
+#else
+        return serve_prometheus(seg, atoi(argv[2]));
+#endif
+    }
+    
+    if (mode == "--watch" && argc > 2) {
+        double interval = atof(argv[2]);
+        if (interval <= 0) interval = 1;
+        
+        MetricsSample before, now;
+        take_sample(seg, &before);
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+            take_sample(seg, &now);
+            printf("\n");
+            print_sample(now, &before, interval);
+            fflush(stdout);
+            before = now;
+        }
+    }
+    
+    if (!mode.empty()) {
+        std::cout << "Использование: counterstat [--watch С | --prometheus | --serve ПОРТ]\n";
+        return 1;
+    }
+    
+    MetricsSample sample;
+    take_sample(seg, &sample);
+    print_sample(sample, nullptr, 0);
+    return 0;
+}
@@ -0,0 +1,325 @@
+#include "event_loop.h"
+#include <iostream>
+#include <thread>
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+    #include <sys/timerfd.h>
+    #include <sys/eventfd.h>
+    #include <sys/signalfd.h>
+#endif
+
+void block_shutdown_signals() {
+#ifdef __linux__
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+#endif
+}
+
+size_t EventLoop::timer_count() const {
+    return timers.size();
+}
+
+const std::string& EventLoop::timer_name(int timer) const {
+    return timers[timer].name;
+}
+
+int EventLoop::timer_period(int timer) const {
+    return timers[timer].period_ms;
+}
+
+bool EventLoop::timer_armed(int timer) const {
+    return timers[timer].armed;
+}
+
+bool EventLoop::set_timer_period(const std::string& name, int period_ms) {
+    if (period_ms <= 0) return false;
+    
+    for (size_t i = 0; i < timers.size(); i++) {
+        if (timers[i].name != name) continue;
+        timers[i].period_ms = period_ms;
+        set_timer_armed((int)i, timers[i].armed);
+        return true;
+    }
+    return false;
+}
+
+void EventLoop::post(Callback callback) {
+    {
+        std::lock_guard<std::mutex> guard(posted_mutex);
+        posted.push_back(callback);
+    }
+#ifdef __linux__
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+#else
+    wake_cv.notify_one();
+#endif
+}
+
+void EventLoop::run_posted() {
+    std::vector<Callback> ready;
+    {
+        std::lock_guard<std::mutex> guard(posted_mutex);
+        ready.swap(posted);
+    }
+    for (Callback& callback : ready) callback();
+}
+
+#ifdef __linux__
+
+EventLoop::EventLoop() : stopping(false), signal_fd(-1) {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd == -1 || wake_fd == -1) {
+        perror("epoll/eventfd");
+        exit(1);
+    }
+    
+    add_fd(wake_fd, [this] {
+        uint64_t value;
+        ssize_t n = read(wake_fd, &value, sizeof(value));
+        (void)n;
+        run_posted();
+    });
+}
+
+EventLoop::~EventLoop() {
+    for (Timer& timer : timers) close(timer.fd);
+    if (signal_fd != -1) close(signal_fd);
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+void EventLoop::add_fd(int fd, Callback on_readable, Callback on_writable) {
+    handlers[fd] = on_readable;
+    if (on_writable) write_handlers[fd] = on_writable;
+    
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void EventLoop::set_fd_events(int fd, bool readable, bool writable) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (readable ? (uint32_t)EPOLLIN : 0u) | (writable ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+void EventLoop::remove_fd(int fd) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    handlers.erase(fd);
+    write_handlers.erase(fd);
+}
+
+void EventLoop::arm(Timer& timer) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    if (timer.armed) {
+        spec.it_interval.tv_sec = timer.period_ms / 1000;
+        spec.it_interval.tv_nsec = (long)(timer.period_ms % 1000) * 1000000L;
+        spec.it_value = spec.it_interval;
+    }
+    timerfd_settime(timer.fd, 0, &spec, nullptr);
+}
+
+int EventLoop::add_timer(const char* name, int period_ms, bool armed, Callback callback) {
+    Timer timer;
+    timer.name = name;
+    timer.period_ms = period_ms;
+    timer.armed = armed;
+    timer.callback = callback;
+    timer.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer.fd == -1) {
+        perror("timerfd_create");
+        exit(1);
+    }
+    
+    int index = (int)timers.size();
+    timers.push_back(timer);
+    arm(timers[index]);
+    
+    int fd = timer.fd;
+    add_fd(fd, [this, index, fd] {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return;
+        if (timers[index].armed) timers[index].callback();
+    });
+    return index;
+}
+
+void EventLoop::set_timer_armed(int timer, bool armed) {
+    timers[timer].armed = armed;
+    arm(timers[timer]);
+}
+
+void EventLoop::watch_stdin(LineCallback on_line, Callback on_eof) {
+    stdin_line = on_line;
+    stdin_eof = on_eof;
+    add_fd(STDIN_FILENO, [this] { read_stdin(); });
+}
+
+void EventLoop::read_stdin() {
+    char chunk[4096];
+    ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) return;
+    
+    if (n <= 0) {
+        remove_fd(STDIN_FILENO);
+        if (!stdin_buffer.empty()) stdin_line(stdin_buffer);
+        stdin_buffer.clear();
+        if (stdin_eof) stdin_eof();
+        return;
+    }
+    
+    stdin_buffer.append(chunk, (size_t)n);
+    size_t start = 0, end;
+    while ((end = stdin_buffer.find('\n', start)) != std::string::npos) {
+        stdin_line(stdin_buffer.substr(start, end - start));
+        start = end + 1;
+    }
+    stdin_buffer.erase(0, start);
+}
+
+void EventLoop::watch_shutdown_signals() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigaddset(&mask, SIGHUP);
+    
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1) {
+        perror("signalfd");
+        exit(1);
+    }
+    
+    add_fd(signal_fd, [this] {
+        struct signalfd_siginfo info;
+        while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+            std::cout << "\nПолучен сигнал завершения. Завершаем работу...\n";
+            stop();
+        }
+    });
+}
+
+void EventLoop::stop() {
+    stopping = true;
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+}
+
+void EventLoop::run() {
+    struct epoll_event events[32];
+    
+    while (!stopping) {
+        int n = epoll_wait(epoll_fd, events, 32, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        
+        for (int i = 0; i < n && !stopping; i++) {
+            int fd = events[i].data.fd;
+            
+            // Обработчик чтения может закрыть fd, поэтому обработчик записи
+            // ищется заново.
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                std::map<int, Callback>::iterator it = handlers.find(fd);
+                if (it != handlers.end()) {
+                    Callback callback = it->second;
+                    callback();
+                }
+            }
+            if (events[i].events & EPOLLOUT) {
+                std::map<int, Callback>::iterator it = write_handlers.find(fd);
+                if (it != write_handlers.end()) {
+                    Callback callback = it->second;
+                    callback();
+                }
+            }
+        }
+    }
+}
+
+#else
+
+static const uint64_t NS_PER_MS = 1000000ull;
+
+EventLoop::EventLoop() : stopping(false) {}
+
+EventLoop::~EventLoop() {}
+
+int EventLoop::add_timer(const char* name, int period_ms, bool armed, Callback callback) {
+    Timer timer;
+    timer.name = name;
+    timer.period_ms = period_ms;
+    timer.armed = armed;
+    timer.callback = callback;
+    timer.next_ns = monotonic_ns() + (uint64_t)period_ms * NS_PER_MS;
+    timers.push_back(timer);
+    return (int)timers.size() - 1;
+}
+
+void EventLoop::set_timer_armed(int timer, bool armed) {
+    timers[timer].armed = armed;
+    timers[timer].next_ns = monotonic_ns() + (uint64_t)timers[timer].period_ms * NS_PER_MS;
+}
+
+void EventLoop::watch_stdin(LineCallback on_line, Callback on_eof) {
+    stdin_line = on_line;
+    stdin_eof = on_eof;
+    
+    std::thread reader([this] {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            post([this, line] { stdin_line(line); });
+        }
+        post([this] { if (stdin_eof) stdin_eof(); });
+    });
+    reader.detach();
+}
+
+void EventLoop::watch_shutdown_signals() {}
+
+void EventLoop::stop() {
+    stopping = true;
+}
+
+void EventLoop::run() {
+    while (!stopping) {
+        uint64_t now = monotonic_ns();
+        uint64_t next = now + 100 * NS_PER_MS;
+        for (Timer& timer : timers) {
+            if (timer.armed && timer.next_ns < next) next = timer.next_ns;
+        }
+        
+        {
+            std::unique_lock<std::mutex> guard(posted_mutex);
+            if (posted.empty() && next > now) {
+                wake_cv.wait_for(guard, std::chrono::nanoseconds(next - now));
+            }
+        }
+        run_posted();
+        
+        now = monotonic_ns();
+        for (size_t i = 0; i < timers.size() && !stopping; i++) {
+            if (!timers[i].armed || timers[i].next_ns > now) continue;
+            timers[i].next_ns = now + (uint64_t)timers[i].period_ms * NS_PER_MS;
+            timers[i].callback();
+        }
+    }
+}
+
+#endif
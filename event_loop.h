@@ -0,0 +1,86 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "platform.h"
+#include <functional>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+// Однопоточный цикл событий процесса. В Linux это epoll: у каждой
+// периодической задачи свой timerfd, stdin и signalfd тоже в epoll, а
+// stop() будит цикл через eventfd. Задача с выключенным таймером не будит
+// процесс вовсе. На остальных платформах - ожидание на condition_variable
+// до ближайшего таймера и отдельный поток чтения stdin.
+class EventLoop {
+public:
+    typedef std::function<void()> Callback;
+    typedef std::function<void(const std::string&)> LineCallback;
+    
+    EventLoop();
+    ~EventLoop();
+    
+    int add_timer(const char* name, int period_ms, bool armed, Callback callback);
+    void set_timer_armed(int timer, bool armed);
+    bool set_timer_period(const std::string& name, int period_ms);
+    size_t timer_count() const;
+    const std::string& timer_name(int timer) const;
+    int timer_period(int timer) const;
+    bool timer_armed(int timer) const;
+    
+    void watch_stdin(LineCallback on_line, Callback on_eof);
+    void watch_shutdown_signals();
+#ifdef __linux__
+    // on_writable вызывается, только пока для fd включено ожидание записи
+    // (set_fd_events).
+    void add_fd(int fd, Callback on_readable, Callback on_writable = Callback());
+    void set_fd_events(int fd, bool readable, bool writable);
+    void remove_fd(int fd);
+#endif
+    void post(Callback callback);
+    void stop();
+    void run();
+    
+private:
+    struct Timer {
+        std::string name;
+        int period_ms;
+        bool armed;
+        Callback callback;
+#ifdef __linux__
+        int fd;
+#else
+        uint64_t next_ns;
+#endif
+    };
+    
+    std::vector<Timer> timers;
+    std::vector<Callback> posted;
+    std::mutex posted_mutex;
+    LineCallback stdin_line;
+    Callback stdin_eof;
+    std::atomic<bool> stopping;
+    
+#ifdef __linux__
+    int epoll_fd;
+    int wake_fd;
+    int signal_fd;
+    std::string stdin_buffer;
+    std::map<int, Callback> handlers;
+    std::map<int, Callback> write_handlers;
+    
+    void arm(Timer& timer);
+    void read_stdin();
+#else
+    std::condition_variable wake_cv;
+#endif
+    
+    void run_posted();
+};
+
+// Блокирует SIGINT/SIGTERM/SIGHUP до запуска потоков, чтобы их получал
+// только signalfd цикла событий (Linux).
+void block_shutdown_signals();
+
+#endif
@@ -0,0 +1,228 @@
+#include "io_ring.h"
+#include <algorithm>
+
+#ifdef __linux__
+    #include <linux/io_uring.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+#endif
+
+// Бит user_data у fdatasync, связанного с записью той же метки.
+#define IO_RING_SYNC 0x100
+
+bool io_ring_enabled() {
+    return env_int("COUNTER_IO_URING", 1) != 0;
+}
+
+IoRing::IoRing()
+    : ring_fd(-1), entries(0), sq_ring(nullptr), cq_ring(nullptr), sq_ring_bytes(0), cq_ring_bytes(0),
+      sqes(nullptr), sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr), sq_array(nullptr),
+      cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr), cqes(nullptr), queued(0), inflight(0),
+      buffer_bytes(0), buffers_registered(false), files_registered(false), syscall_count(0) {
+    for (int i = 0; i < IO_RING_TAGS; i++) results[i] = 0;
+}
+
+IoRing::~IoRing() {
+    if (available()) complete();
+    release();
+}
+
+#ifdef __linux__
+
+bool IoRing::setup(unsigned count, int buffer_count, size_t bytes, int file_count) {
+    if (!io_ring_enabled()) return false;
+    
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd = (int)syscall(__NR_io_uring_setup, count, &params);
+    if (ring_fd < 0) {
+        ring_fd = -1;
+        return false;
+    }
+    entries = params.sq_entries;
+    
+    sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) sq_ring_bytes = cq_ring_bytes = std::max(sq_ring_bytes, cq_ring_bytes);
+    
+    sq_ring = mmap(NULL, sq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) sq_ring = nullptr;
+    cq_ring = single_mmap ? sq_ring
+                          : mmap(NULL, cq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    if (cq_ring == MAP_FAILED) cq_ring = nullptr;
+    sqes = mmap(NULL, entries * sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) sqes = nullptr;
+    if (!sq_ring || !cq_ring || !sqes) {
+        release();
+        return false;
+    }
+    
+    char* sq = (char*)sq_ring;
+    sq_head = (unsigned*)(sq + params.sq_off.head);
+    sq_tail = (unsigned*)(sq + params.sq_off.tail);
+    sq_mask = (unsigned*)(sq + params.sq_off.ring_mask);
+    sq_array = (unsigned*)(sq + params.sq_off.array);
+    char* cq = (char*)cq_ring;
+    cq_head = (unsigned*)(cq + params.cq_off.head);
+    cq_tail = (unsigned*)(cq + params.cq_off.tail);
+    cq_mask = (unsigned*)(cq + params.cq_off.ring_mask);
+    cqes = cq + params.cq_off.cqes;
+    
+    buffer_bytes = bytes;
+    std::vector<struct iovec> iov;
+    for (int i = 0; i < buffer_count; i++) {
+        char* buf = (char*)mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buf == MAP_FAILED) {
+            release();
+            return false;
+        }
+        buffers.push_back(buf);
+        iov.push_back({ buf, bytes });
+    }
+    
+    syscall_count.fetch_add(2, std::memory_order_relaxed);
+    buffers_registered = buffer_count > 0 &&
+        syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, iov.data(), (unsigned)buffer_count) == 0;
+    files.assign(file_count, -1);
+    files_registered = file_count > 0 &&
+        syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_FILES, files.data(), (unsigned)file_count) == 0;
+    return true;
+}
+
+void IoRing::release() {
+    for (char* buf : buffers) munmap(buf, buffer_bytes);
+    buffers.clear();
+    if (sqes) munmap(sqes, entries * sizeof(struct io_uring_sqe));
+    if (cq_ring && cq_ring != sq_ring) munmap(cq_ring, cq_ring_bytes);
+    if (sq_ring) munmap(sq_ring, sq_ring_bytes);
+    sqes = sq_ring = cq_ring = nullptr;
+    if (ring_fd != -1) close(ring_fd);
+    ring_fd = -1;
+}
+
+bool IoRing::set_file(int slot, int fd) {
+    files[slot] = fd;
+    if (!files_registered) return true;
+    
+    struct io_uring_files_update update;
+    memset(&update, 0, sizeof(update));
+    update.offset = (unsigned)slot;
+    update.fds = (uint64_t)(uintptr_t)&files[slot];
+    syscall_count.fetch_add(1, std::memory_order_relaxed);
+    // Без регистрации слоты продолжают работать по номерам дескрипторов.
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0) {
+        files_registered = false;
+    }
+    return true;
+}
+
+static struct io_uring_sqe* sqe_at(void* sqes, unsigned* array, unsigned mask, unsigned tail) {
+    unsigned index = tail & mask;
+    struct io_uring_sqe* sqe = (struct io_uring_sqe*)sqes + index;
+    memset(sqe, 0, sizeof(*sqe));
+    array[index] = index;
+    return sqe;
+}
+
+bool IoRing::queue_write(int slot, int index, size_t length, uint64_t offset, bool sync, int tag) {
+    unsigned need = sync ? 2 : 1;
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *sq_tail;
+    // CQ вдвое больше SQ, так что при этом условии переполниться не может.
+    if (entries - (tail - head) < need || queued + inflight + need > entries) return false;
+    
+    unsigned mask = *sq_mask;
+    int fd = files_registered ? slot : files[slot];
+    uint8_t flags = files_registered ? IOSQE_FIXED_FILE : 0;
+    
+    struct io_uring_sqe* write = sqe_at(sqes, sq_array, mask, tail++);
+    write->opcode = buffers_registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    write->fd = fd;
+    write->flags = flags | (sync ? IOSQE_IO_LINK : 0);
+    write->off = offset;
+    write->addr = (uint64_t)(uintptr_t)buffers[index];
+    write->len = (uint32_t)length;
+    write->buf_index = buffers_registered ? (uint16_t)index : 0;
+    write->user_data = (uint64_t)tag;
+    
+    if (sync) {
+        struct io_uring_sqe* fsync = sqe_at(sqes, sq_array, mask, tail++);
+        fsync->opcode = IORING_OP_FSYNC;
+        fsync->fd = fd;
+        fsync->flags = flags;
+        fsync->fsync_flags = IORING_FSYNC_DATASYNC;
+        fsync->user_data = (uint64_t)tag | IO_RING_SYNC;
+    }
+    
+    __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+    queued += need;
+    results[tag] = 0;
+    return true;
+}
+
+int IoRing::enter(unsigned to_submit, unsigned min_complete) {
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    while (true) {
+        syscall_count.fetch_add(1, std::memory_order_relaxed);
+        int rc = (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, 0);
+        if (rc >= 0 || errno != EINTR) return rc;
+    }
+}
+
+void IoRing::reap() {
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    unsigned mask = *cq_mask;
+    
+    while (head != tail) {
+        const struct io_uring_cqe* cqe = (const struct io_uring_cqe*)cqes + (head & mask);
+        int tag = (int)(cqe->user_data & (IO_RING_SYNC - 1));
+        if (!(cqe->user_data & IO_RING_SYNC)) {
+            results[tag] = cqe->res;
+        } else if (cqe->res < 0 && cqe->res != -ECANCELED && results[tag] >= 0) {
+            // Отмена fdatasync означает неудачную запись, ее результат важнее.
+            results[tag] = cqe->res;
+        }
+        inflight--;
+        head++;
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+void IoRing::submit(bool wait) {
+    if (queued > 0) {
+        int rc = enter(queued, wait ? queued + inflight : 0);
+        if (rc > 0) {
+            queued -= (unsigned)rc;
+            inflight += (unsigned)rc;
+        }
+    }
+    reap();
+    if (wait) complete();
+}
+
+void IoRing::complete() {
+    reap();
+    while (queued + inflight > 0) {
+        int rc = enter(queued, queued + inflight);
+        if (rc < 0) break;
+        queued -= (unsigned)rc;
+        inflight += (unsigned)rc;
+        reap();
+    }
+}
+
+#else
+
+bool IoRing::setup(unsigned, int, size_t, int) { return false; }
+void IoRing::release() {}
+bool IoRing::set_file(int, int) { return false; }
+bool IoRing::queue_write(int, int, size_t, uint64_t, bool, int) { return false; }
+int IoRing::enter(unsigned, unsigned) { return -1; }
+void IoRing::reap() {}
+void IoRing::submit(bool) {}
+void IoRing::complete() {}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include "platform.h"
+#include <vector>
+
+// Асинхронная запись в файлы через io_uring (Linux, системные вызовы без
+// liburing). Буферы и дескрипторы регистрируются в ядре один раз; запись
+// из буфера и fdatasync ставятся связанной парой (IOSQE_IO_LINK) и
+// отправляются вместе с остальной очередью одним io_uring_enter.
+// Завершения читаются из CQ в памяти, системный вызов нужен только для
+// ожидания незавершенных.
+//
+// setup() возвращает false, если io_uring недоступен (старое ядро, запрет
+// через /proc/sys/kernel/io_uring_disabled, seccomp, не Linux) или выключен
+// COUNTER_IO_URING=0; тогда вызывающий пишет синхронно. Если не удалось
+// зарегистрировать буферы (RLIMIT_MEMLOCK) или дескрипторы, используются
+// обычные IORING_OP_WRITE и номера дескрипторов.
+#define IO_RING_TAGS 4
+
+bool io_ring_enabled();
+
+class IoRing {
+public:
+    IoRing();
+    ~IoRing();
+    
+    bool setup(unsigned entries, int buffers, size_t buffer_bytes, int files);
+    bool available() const { return ring_fd != -1; }
+    char* buffer(int index) const { return buffers[index]; }
+    size_t buffer_size() const { return buffer_bytes; }
+    
+    // Ставит fd в слот slot вместо прежнего.
+    bool set_file(int slot, int fd);
+    
+    // Ставит в очередь запись length байт из буфера index в файл слота slot
+    // по смещению offset (-1 - текущая позиция, для O_APPEND - конец файла)
+    // и, если sync, связанный с ней fdatasync. Буфер нельзя менять до
+    // завершения. false - очередь полна.
+    bool queue_write(int slot, int index, size_t length, uint64_t offset, bool sync, int tag);
+    // Отправляет очередь; wait - дождаться завершения всего отправленного
+    // тем же вызовом.
+    void submit(bool wait);
+    // Дожидается завершения всего отправленного.
+    void complete();
+    bool busy() const { return inflight > 0; }
+    
+    // Результат последней завершенной записи с меткой tag: число байт или
+    // -errno записи либо ее fdatasync.
+    int result(int tag) const { return results[tag]; }
+    uint64_t syscalls() const { return syscall_count.load(std::memory_order_relaxed); }
+
+private:
+    int ring_fd;
+    unsigned entries;
+    void* sq_ring;
+    void* cq_ring;
+    size_t sq_ring_bytes;
+    size_t cq_ring_bytes;
+    void* sqes;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    void* cqes;
+    unsigned queued;
+    unsigned inflight;
+    
+    std::vector<char*> buffers;
+    size_t buffer_bytes;
+    bool buffers_registered;
+    std::vector<int> files;
+    bool files_registered;
+    int results[IO_RING_TAGS];
+    std::atomic<uint64_t> syscall_count;
+    
+    void reap();
+    int enter(unsigned to_submit, unsigned min_complete);
+    void release();
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "log_events.h"
+#include "participants.h"
+#include <string>
+
+static const char* const EVENT_NAMES[LOG_EV_TYPES] = {
+    "none", "counter", "start", "end", "exit", "spawn_skip",
+    "leader_promoted", "leader_lost", "manual_set", "main_start", "main_exit", "reaped"
+};
+
+const char* log_filename() {
+    const char* name = getenv("COUNTER_LOG_FILE");
+    return (name && *name) ? name : "counter_log.txt";
+}
+
+const char* log_binary_filename() {
+    static std::string name;
+    if (name.empty()) {
+        name = log_filename();
+        size_t dot = name.size() >= 4 ? name.size() - 4 : std::string::npos;
+        if (dot != std::string::npos && name.compare(dot, 4, ".txt") == 0) name.erase(dot);
+        name += ".bin";
+    }
+    return name.c_str();
+}
+
+bool log_binary_enabled() {
+    static const bool enabled = [] {
+        const char* format = getenv("COUNTER_LOG_FORMAT");
+        return format && strcmp(format, "binary") == 0;
+    }();
+    return enabled;
+}
+
+const char* log_event_type_name(int type) {
+    return type > LOG_EV_NONE && type < LOG_EV_TYPES ? EVENT_NAMES[type] : "none";
+}
+
+int log_event_type_from_name(const char* name) {
+    for (int type = LOG_EV_NONE + 1; type < LOG_EV_TYPES; type++) {
+        if (strcmp(name, EVENT_NAMES[type]) == 0) return type;
+    }
+    return LOG_EV_NONE;
+}
+
+static const char* job_name(int role) {
+    switch (role) {
+    case ROLE_CHILD1: return "CHILD1";
+    case ROLE_CHILD2: return "CHILD2";
+    case ROLE_WORKER: return "WORKER";
+    }
+    return "?";
+}
+
+size_t log_event_format(const LogEvent& ev, const char* ts, char* buf, size_t size) {
+    long long pid = ev.pid;
+    long long value = ev.value;
+    int n = 0;
+    
+    switch (ev.type) {
+    case LOG_EV_COUNTER:
+        n = snprintf(buf, size, "[%s] PID=%lld COUNTER=%lld", ts, pid, value);
+        break;
+    case LOG_EV_START:
+        n = snprintf(buf, size, "[%s] %s START PID=%lld", ts, job_name(ev.role), pid);
+        break;
+    case LOG_EV_END:
+        if (ev.role == ROLE_WORKER) {
+            n = snprintf(buf, size, "[%s] WORKER EXIT PID=%lld", ts, pid);
+        } else {
+            n = snprintf(buf, size, "[%s] %s END PID=%lld COUNTER=%lld%s", ts, job_name(ev.role), pid, value,
+                         ev.aux ? " (undo skipped: counter was set)" : "");
+        }
+        break;
+    case LOG_EV_EXIT:
+        n = snprintf(buf, size, "[%s] PID=%lld %s EXIT PID=%lld STATUS=%d RUNTIME_MS=%lld",
+                     ts, pid, job_name(ev.role), value, (int)ev.aux, (long long)ev.arg);
+        break;
+    case LOG_EV_SPAWN_SKIP:
+        n = snprintf(buf, size, "[%s] PID=%lld WARNING: %s (PID=%lld) still running, skipping spawn",
+                     ts, pid, ev.role == ROLE_CHILD1 ? "Child1" : "Child2", value);
+        break;
+    case LOG_EV_LEADER_PROMOTED:
+    case LOG_EV_LEADER_LOST:
+        n = snprintf(buf, size, "[%s] PID=%lld %s EPOCH=%llu", ts, pid,
+                     ev.type == LOG_EV_LEADER_PROMOTED ? "LEADER PROMOTED" : "LEADER LOST",
+                     (unsigned long long)ev.arg);
+        break;
+    case LOG_EV_MANUAL_SET:
+        n = snprintf(buf, size, "[%s] PID=%lld MANUAL_SET COUNTER=%lld", ts, pid, value);
+        break;
+    case LOG_EV_MAIN_START:
+        n = snprintf(buf, size, "[%s] MAIN START PID=%lld (Leader: %s)", ts, pid, ev.aux ? "YES" : "NO");
+        break;
+    case LOG_EV_MAIN_EXIT:
+        n = snprintf(buf, size, "[%s] MAIN EXIT PID=%lld COUNTER=%lld", ts, pid, value);
+        break;
+    case LOG_EV_REAPED:
+        n = snprintf(buf, size, "[%s] PID=%lld PARTICIPANT REAPED PID=%lld ROLE=%s",
+                     ts, pid, value, participant_role_name(ev.role));
+        break;
+    default:
+        n = snprintf(buf, size, "[%s] PID=%lld EVENT %d VALUE=%lld", ts, pid, (int)ev.type, value);
+        break;
+    }
+    
+    if (n < 0) n = 0;
+    return (size_t)n < size ? (size_t)n : size - 1;
+}
@@ -0,0 +1,54 @@
+#ifndef LOG_EVENTS_H
+#define LOG_EVENTS_H
+
+#include "platform.h"
+
+// Структурированные события лога. При COUNTER_LOG_FORMAT=binary log_event()
+// кладет в общий LogRing запись LogEvent фиксированной длины, и лидер пишет
+// ее в отдельный файл (log_binary_filename()), без форматирования. Иначе
+// событие сразу превращается в привычную текстовую строку. Текст в обоих
+// случаях строит log_event_format, поэтому экспорт двоичного лога
+// (counterlog --export) совпадает с текстовым логом построчно.
+enum LogEventType {
+    LOG_EV_NONE,
+    LOG_EV_COUNTER,         // value - значение счетчика
+    LOG_EV_START,           // role - child1/child2/worker
+    LOG_EV_END,             // role; value - счетчик; aux=1 - отмена пропущена
+    LOG_EV_EXIT,            // role; value - PID; arg - время работы, мс; aux - код
+    LOG_EV_SPAWN_SKIP,      // role; value - PID еще работающего задания
+    LOG_EV_LEADER_PROMOTED, // arg - эпоха аренды
+    LOG_EV_LEADER_LOST,     // arg - эпоха аренды
+    LOG_EV_MANUAL_SET,      // value - новое значение
+    LOG_EV_MAIN_START,      // aux=1 - процесс стал лидером сразу
+    LOG_EV_MAIN_EXIT,       // value - счетчик
+    LOG_EV_REAPED,          // role; value - PID освобожденного слота
+    LOG_EV_TYPES
+};
+
+// 32 байта; порядок полей исключает выравнивающие пробелы.
+struct LogEvent {
+    uint64_t ts_ns;
+    int64_t value;
+    int64_t arg;
+    int32_t pid;
+    uint8_t type;
+    uint8_t role;
+    int16_t aux;
+};
+
+static_assert(sizeof(LogEvent) == 32, "LogEvent is a fixed-width on-disk record");
+
+// Имена файлов лога (COUNTER_LOG_FILE) и выбор формата (COUNTER_LOG_FORMAT).
+const char* log_filename();
+// Файл двоичного лога: имя текстового с расширением .bin вместо .txt.
+const char* log_binary_filename();
+bool log_binary_enabled();
+
+const char* log_event_type_name(int type);
+// LOG_EV_NONE, если имя неизвестно.
+int log_event_type_from_name(const char* name);
+
+// Строка без '\n' в формате текстового лога; ts - готовая метка времени.
+size_t log_event_format(const LogEvent& ev, const char* ts, char* buf, size_t size);
+
+#endif
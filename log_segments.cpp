@@ -0,0 +1,335 @@
+#include "log_segments.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+    #include <io.h>
+#else
+    #include <dirent.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+    extern char** environ;
+#endif
+
+// Сегмент, записанный меньше этого времени назад, не сжимается: прежний
+// лидер может еще дописывать в него, пока не заметит ротацию.
+#define SEGMENT_SETTLE_S 5
+
+LogSegmentConfig log_segment_config_from_env() {
+    LogSegmentConfig cfg;
+    int segment_kb = env_int("COUNTER_LOG_SEGMENT_KB", 65536);
+    cfg.segment_bytes = segment_kb > 0 ? (uint64_t)segment_kb * 1024 : 0;
+    cfg.rotate_interval_s = env_int("COUNTER_LOG_ROTATE_S", 0);
+    cfg.keep_segments = env_int("COUNTER_LOG_KEEP", 8);
+    cfg.compress = env_int("COUNTER_LOG_COMPRESS", 1) != 0;
+    if (cfg.rotate_interval_s < 0) cfg.rotate_interval_s = 0;
+    if (cfg.keep_segments < 1) cfg.keep_segments = 1;
+    return cfg;
+}
+
+static bool file_exists(const std::string& name) {
+#ifdef _WIN32
+    return GetFileAttributesA(name.c_str()) != INVALID_FILE_ATTRIBUTES;
+#else
+    struct stat st;
+    return stat(name.c_str(), &st) == 0;
+#endif
+}
+
+static time_t file_mtime(const std::string& name) {
+    struct stat st;
+    return stat(name.c_str(), &st) == 0 ? st.st_mtime : 0;
+}
+
+static void split_path(const char* path, std::string* dir, std::string* base) {
+    std::string full(path);
+    size_t slash = full.find_last_of("/\\");
+    if (slash == std::string::npos) {
+        *dir = "";
+        *base = full;
+    } else {
+        *dir = full.substr(0, slash + 1);
+        *base = full.substr(slash + 1);
+    }
+}
+
+// Закрытые сегменты: ИМЯ.<цифры...>[.gz], без каталога.
+static std::vector<std::string> list_segments(const char* path) {
+    std::string dir, base;
+    split_path(path, &dir, &base);
+    std::string prefix = base + ".";
+    std::vector<std::string> names;
+
+#ifdef _WIN32
+    WIN32_FIND_DATAA found;
+    HANDLE search = FindFirstFileA((std::string(path) + ".*").c_str(), &found);
+    if (search == INVALID_HANDLE_VALUE) return names;
+    do {
+        std::string name = found.cFileName;
+        if (name.size() > prefix.size() && isdigit((unsigned char)name[prefix.size()])) names.push_back(name);
+    } while (FindNextFileA(search, &found));
+    FindClose(search);
+#else
+    DIR* d = opendir(dir.empty() ? "." : dir.c_str());
+    if (!d) return names;
+    while (struct dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+            isdigit((unsigned char)name[prefix.size()])) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+#endif
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+static bool ends_with_gz(const std::string& name) {
+    return name.size() > 3 && name.compare(name.size() - 3, 3, ".gz") == 0;
+}
+
+std::vector<std::string> log_segment_files(const char* path) {
+    std::string dir, base;
+    split_path(path, &dir, &base);
+    std::vector<std::string> files;
+    for (const std::string& name : list_segments(path)) {
+        if (!ends_with_gz(name)) files.push_back(dir + name);
+    }
+    return files;
+}
+
+#ifndef _WIN32
+static bool gzip_file(const std::string& file) {
+    const char* argv[] = { "gzip", "-f", "-q", "--", file.c_str(), nullptr };
+    
+    posix_spawnattr_t attr;
+    sigset_t empty;
+    sigemptyset(&empty);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    pid_t pid;
+    int rc = posix_spawnp(&pid, "gzip", nullptr, &attr, (char* const*)argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if (rc != 0) return false;
+    
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) return false;
+    }
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+#endif
+
+int log_segments_housekeep(const char* path, int keep_segments, bool compress) {
+    std::string dir, base;
+    split_path(path, &dir, &base);
+    int deferred = 0;
+
+#ifndef _WIN32
+    if (compress) {
+        time_t now = time(nullptr);
+        for (const std::string& name : list_segments(path)) {
+            if (ends_with_gz(name)) continue;
+            if (now - file_mtime(dir + name) < SEGMENT_SETTLE_S) {
+                deferred++;
+                continue;
+            }
+            if (!gzip_file(dir + name)) break;
+        }
+    }
+#else
+    (void)compress;
+#endif
+    
+    // Сегмент и его .gz (при прерванном сжатии есть оба) считаются одним.
+    std::vector<std::string> stems;
+    for (const std::string& name : list_segments(path)) {
+        stems.push_back(ends_with_gz(name) ? name.substr(0, name.size() - 3) : name);
+    }
+    std::sort(stems.begin(), stems.end());
+    stems.erase(std::unique(stems.begin(), stems.end()), stems.end());
+    
+    for (size_t i = 0; i + keep_segments < stems.size(); i++) {
+        remove((dir + stems[i]).c_str());
+        remove((dir + stems[i] + ".gz").c_str());
+    }
+    return deferred;
+}
+
+LogSegmentWriter::LogSegmentWriter(const char* path, const LogSegmentConfig& cfg)
+    : path(path), config(cfg), handle(LOG_HANDLE_NONE), size(0), opened_at(0), checked_at(0),
+      rotation_count(0), open_count(0), compress_requested(false), stopping(false) {
+#ifndef _WIN32
+    inode = 0;
+#endif
+}
+
+LogSegmentWriter::~LogSegmentWriter() {
+    {
+        std::lock_guard<std::mutex> guard(compress_mutex);
+        stopping = true;
+    }
+    compress_cv.notify_one();
+    if (compressor.joinable()) compressor.join();
+    close_active();
+}
+
+bool LogSegmentWriter::open_active() {
+#ifdef _WIN32
+    handle = CreateFileA(path,
+                         FILE_APPEND_DATA,
+                         FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                         NULL,
+                         OPEN_ALWAYS,
+                         FILE_ATTRIBUTE_NORMAL,
+                         NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+    
+    LARGE_INTEGER file_size;
+    size = GetFileSizeEx(handle, &file_size) ? (uint64_t)file_size.QuadPart : 0;
+#else
+    handle = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (handle == -1) return false;
+    
+    struct stat st;
+    fstat(handle, &st);
+    size = (uint64_t)st.st_size;
+    inode = st.st_ino;
+#ifdef __linux__
+    if (config.segment_bytes > size) {
+        fallocate(handle, FALLOC_FL_KEEP_SIZE, (off_t)size, (off_t)(config.segment_bytes - size));
+    }
+#endif
+#endif
+    opened_at = time(nullptr);
+    open_count++;
+    return true;
+}
+
+void LogSegmentWriter::close_active() {
+    if (handle == LOG_HANDLE_NONE) return;
+#ifdef _WIN32
+    CloseHandle(handle);
+#else
+#ifdef __linux__
+    // Освобождает место, выделенное fallocate за концом файла.
+    off_t end = lseek(handle, 0, SEEK_END);
+    if (end >= 0) {
+        int rc = ftruncate(handle, end);
+        (void)rc;
+    }
+#endif
+    close(handle);
+#endif
+    handle = LOG_HANDLE_NONE;
+}
+
+// Активный файл мог переименовать другой процесс (прежний или новый лидер).
+bool LogSegmentWriter::replaced_by_other_writer() {
+#ifdef _WIN32
+    return false;
+#else
+    struct stat st;
+    return stat(path, &st) != 0 || st.st_ino != inode;
+#endif
+}
+
+void LogSegmentWriter::rotate() {
+    close_active();
+    
+    time_t now = time(nullptr);
+    struct tm local;
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &local);
+    
+    std::string target = std::string(path) + "." + stamp;
+    for (int i = 1; file_exists(target) || file_exists(target + ".gz"); i++) {
+        target = std::string(path) + "." + stamp + "-" + std::to_string(i);
+    }
+
+#ifdef _WIN32
+    MoveFileExA(path, target.c_str(), 0);
+#else
+    rename(path, target.c_str());
+#endif
+    rotation_count++;
+    open_active();
+    request_housekeeping();
+}
+
+log_handle_t LogSegmentWriter::acquire(size_t bytes) {
+    if (handle == LOG_HANDLE_NONE && !open_active()) return LOG_HANDLE_NONE;
+    if (config.segment_bytes == 0 && config.rotate_interval_s == 0) return handle;
+    
+    time_t now = time(nullptr);
+    if (now != checked_at) {
+        checked_at = now;
+        if (replaced_by_other_writer()) {
+            close_active();
+            if (!open_active()) return LOG_HANDLE_NONE;
+        }
+    }
+    
+    bool full = config.segment_bytes > 0 && size > 0 && size + bytes > config.segment_bytes;
+    bool expired = config.rotate_interval_s > 0 && size > 0 && now - opened_at >= config.rotate_interval_s;
+    if (full || expired) rotate();
+    return handle;
+}
+
+void LogSegmentWriter::written(size_t bytes) {
+    size += bytes;
+}
+
+void LogSegmentWriter::request_housekeeping() {
+    {
+        std::lock_guard<std::mutex> guard(compress_mutex);
+        compress_requested = true;
+    }
+    if (!compressor.joinable()) {
+        compressor = std::thread(&LogSegmentWriter::compressor_loop, this);
+    } else {
+        compress_cv.notify_one();
+    }
+}
+
+// Поток с наименьшим приоритетом CPU и ввода-вывода; gzip наследует его.
+void LogSegmentWriter::compressor_loop() {
+#ifdef _WIN32
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__linux__)
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, (id_t)tid, 19);
+    const int IOPRIO_WHO_PROCESS = 1, IOPRIO_CLASS_IDLE = 3, IOPRIO_CLASS_SHIFT = 13;
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+#endif
+    
+    std::unique_lock<std::mutex> guard(compress_mutex);
+    int deferred = 0;
+    while (!stopping) {
+        // Отложенные как недавно записанные сегменты подбираются повтором
+        // через SEGMENT_SETTLE_S.
+        if (deferred > 0) {
+            compress_cv.wait_for(guard, std::chrono::seconds(SEGMENT_SETTLE_S),
+                                 [&] { return stopping || compress_requested; });
+        } else {
+            compress_cv.wait(guard, [&] { return stopping || compress_requested; });
+        }
+        if (stopping) break;
+        compress_requested = false;
+        
+        guard.unlock();
+        deferred = log_segments_housekeep(path, config.keep_segments, config.compress);
+        guard.lock();
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef LOG_SEGMENTS_H
+#define LOG_SEGMENTS_H
+
+#include "platform.h"
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <string>
+
+// Файл лога из сегментов: запись всегда идет в активный файл (имя лога),
+// который при превышении размера или по времени переименовывается в
+// ИМЯ.ГГГГММДД-ччммсс, а на его месте открывается новый. Закрытые сегменты
+// сжимает gzip из фонового потока с низким приоритетом; сверх заданного
+// числа самые старые удаляются.
+//
+// В Linux место под активный сегмент выделяется заранее (fallocate с
+// FALLOC_FL_KEEP_SIZE), поэтому дописывание строк не выделяет блоки.
+//
+// Параметры из окружения:
+//   COUNTER_LOG_SEGMENT_KB - размер сегмента (65536; 0 - без ротации)
+//   COUNTER_LOG_ROTATE_S   - ротация по времени (0 - выключена)
+//   COUNTER_LOG_KEEP       - сколько закрытых сегментов хранить (8)
+//   COUNTER_LOG_COMPRESS   - сжимать закрытые сегменты gzip (1)
+struct LogSegmentConfig {
+    uint64_t segment_bytes;
+    int rotate_interval_s;
+    int keep_segments;
+    bool compress;
+};
+
+LogSegmentConfig log_segment_config_from_env();
+
+#ifdef _WIN32
+typedef HANDLE log_handle_t;
+#define LOG_HANDLE_NONE INVALID_HANDLE_VALUE
+#else
+typedef int log_handle_t;
+#define LOG_HANDLE_NONE -1
+#endif
+
+class LogSegmentWriter {
+public:
+    LogSegmentWriter(const char* path, const LogSegmentConfig& cfg);
+    ~LogSegmentWriter();
+    
+    // Дескриптор для записи bytes байт (дописывание в конец); перед этим
+    // при необходимости выполняет ротацию. LOG_HANDLE_NONE - файл не открыть.
+    log_handle_t acquire(size_t bytes);
+    void written(size_t bytes);
+    
+    uint64_t rotations() const { return rotation_count; }
+    // Меняется при каждом открытии активного файла (ротация, замена).
+    uint64_t generation() const { return open_count; }
+
+private:
+    const char* path;
+    LogSegmentConfig config;
+    log_handle_t handle;
+    uint64_t size;
+    time_t opened_at;
+    time_t checked_at;
+    uint64_t rotation_count;
+    uint64_t open_count;
+#ifndef _WIN32
+    ino_t inode;
+#endif
+    
+    std::thread compressor;
+    std::mutex compress_mutex;
+    std::condition_variable compress_cv;
+    bool compress_requested;
+    bool stopping;
+    
+    bool open_active();
+    void close_active();
+    bool replaced_by_other_writer();
+    void rotate();
+    void compressor_loop();
+    void request_housekeeping();
+};
+
+// Закрытые несжатые сегменты лога path (с каталогом), от старых к новым.
+std::vector<std::string> log_segment_files(const char* path);
+
+// Сжатие и удаление старых сегментов лога path; возвращает число
+// сегментов, отложенных как недавно записанные. Вызывается из потока
+// LogSegmentWriter.
+int log_segments_housekeep(const char* path, int keep_segments, bool compress);
+
+#endif
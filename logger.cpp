@@ -0,0 +1,489 @@
+#include "logger.h"
+#include "trace.h"
+
+#ifndef _WIN32
+    #include <sys/uio.h>
+    #include <limits.h>
+#endif
+
+
+static AsyncLogger* g_logger = nullptr;
+static std::atomic<LogRing*> g_ring{nullptr};
+static bool g_logger_closed = false;
+static std::atomic<bool> g_sync{false};
+static std::mutex g_logger_mutex;
+
+// Метки (и номера буфера и слота дескриптора) записей io_uring.
+#define LOG_IO_TEXT 0
+#define LOG_IO_BINARY 1
+// Пачка больше буфера пишется синхронно; общее кольцо выгружается
+// целиком не больше чем в LOG_RING_SLOTS * LOG_RECORD_SIZE байт.
+#define LOG_IO_BUFFER (512 * 1024)
+// Слот LogRing, который писатель зарезервировал и не опубликовал за это
+// время (умер между CAS по head и публикацией), пропускается.
+#define LOG_RING_STUCK_NS (1000ull * 1000 * 1000)
+
+LoggerConfig logger_config_from_env() {
+    LoggerConfig cfg;
+    cfg.flush_interval_ms = env_int("COUNTER_LOG_FLUSH_MS", 50);
+    cfg.max_batch = (size_t)env_int("COUNTER_LOG_BATCH", 64);
+    cfg.queue_capacity = (size_t)env_int("COUNTER_LOG_QUEUE", 4096);
+    if (cfg.flush_interval_ms < 1) cfg.flush_interval_ms = 1;
+    if (cfg.max_batch < 1) cfg.max_batch = 1;
+#ifdef IOV_MAX
+    if (cfg.max_batch > IOV_MAX) cfg.max_batch = IOV_MAX;
+#endif
+    if (cfg.queue_capacity < cfg.max_batch) cfg.queue_capacity = cfg.max_batch;
+    cfg.fsync = env_int("COUNTER_LOG_FSYNC", 0) != 0;
+    cfg.io_uring = io_ring_enabled();
+    cfg.segments = log_segment_config_from_env();
+    return cfg;
+}
+
+AsyncLogger::AsyncLogger(const char* name, const LoggerConfig& cfg)
+    : config(cfg), output(name, cfg.segments), binary_output(log_binary_filename(), cfg.segments), drain_ring(nullptr), ring_stuck_pos(UINT64_MAX), ring_stuck_since(0), dropped(0), stopping(false), flush_requested(false), passes_started(0), passes_done(0), io_batches(0), sync_syscalls(0) {
+    for (int tag = LOG_IO_TEXT; tag <= LOG_IO_BINARY; tag++) {
+        uring_generation[tag] = 0;
+        uring_handle[tag] = LOG_HANDLE_NONE;
+        uring_length[tag] = 0;
+    }
+    pending.reserve(config.max_batch);
+    writer = std::thread(&AsyncLogger::writer_loop, this);
+}
+
+AsyncLogger::~AsyncLogger() {
+    {
+        std::lock_guard<std::mutex> guard(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_one();
+    if (writer.joinable()) writer.join();
+}
+
+void AsyncLogger::enqueue(const char* message) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> guard(queue_mutex);
+        if (pending.size() >= config.queue_capacity) {
+            dropped++;
+            return;
+        }
+        pending.emplace_back(message);
+        pending.back() += '\n';
+        wake = (pending.size() == config.max_batch);
+    }
+    if (wake) queue_cv.notify_one();
+}
+
+void AsyncLogger::flush() {
+    std::unique_lock<std::mutex> guard(queue_mutex);
+    uint64_t target = passes_started + 1;
+    flush_requested = true;
+    queue_cv.notify_one();
+    flushed_cv.wait(guard, [&] { return passes_done >= target || stopping; });
+}
+
+void AsyncLogger::set_drain_ring(LogRing* ring) {
+    std::lock_guard<std::mutex> guard(queue_mutex);
+    drain_ring = ring;
+}
+
+LogIoStats AsyncLogger::io_stats() const {
+    LogIoStats stats;
+    stats.io_uring = uring.available();
+    stats.batches = io_batches.load(std::memory_order_relaxed);
+    stats.syscalls = sync_syscalls.load(std::memory_order_relaxed) + uring.syscalls();
+    return stats;
+}
+
+void AsyncLogger::writer_loop() {
+    // Кольцо создается в потоке, который им пользуется.
+    if (config.io_uring) uring.setup(8, 2, LOG_IO_BUFFER, 2);
+    
+    std::unique_lock<std::mutex> guard(queue_mutex);
+    
+    while (true) {
+        queue_cv.wait_for(guard, std::chrono::milliseconds(config.flush_interval_ms),
+                          [&] { return stopping || flush_requested || pending.size() >= config.max_batch; });
+        // После flush() и при остановке записи должны быть в файле.
+        bool wait_io = flush_requested || stopping;
+        flush_requested = false;
+        
+        writing.swap(pending);
+        uint64_t pass = ++passes_started;
+        uint64_t batch_dropped = dropped;
+        dropped = 0;
+        LogRing* ring = drain_ring;
+        bool last_pass = stopping;
+        
+        guard.unlock();
+        if (batch_dropped > 0) {
+            char note[128];
+            snprintf(note, sizeof(note), "PID=%lld WARNING: log queue overflow, %llu lines dropped\n",
+                    (long long)get_current_pid(), (unsigned long long)batch_dropped);
+            writing.emplace_back(note);
+        }
+        if (ring) drain_ring_into(ring, writing, binary_writing);
+        
+        // Прежние записи io_uring обычно уже завершены, и их итог читается
+        // из CQ без системного вызова.
+        if (uring.available()) finish_uring_writes();
+        size_t lines = writing.size() + binary_writing.size() / sizeof(LogEvent);
+        if (lines > 0) {
+            io_batches.fetch_add(1, std::memory_order_relaxed);
+            trace_begin(TRACE_LOG_FLUSH);
+        }
+        if (!writing.empty()) write_batch(writing);
+        if (!binary_writing.empty()) write_binary(binary_writing);
+        if (uring.available()) {
+            uring.submit(wait_io);
+            if (wait_io) finish_uring_writes();
+        }
+        if (lines > 0) trace_end(TRACE_LOG_FLUSH, (int64_t)lines);
+        writing.clear();
+        binary_writing.clear();
+        guard.lock();
+        
+        passes_done = pass;
+        flushed_cv.notify_all();
+        if (last_pass) break;
+    }
+}
+
+void AsyncLogger::drain_ring_into(LogRing* ring, std::vector<std::string>& batch, std::string& binary) {
+    uint64_t pos = ring->tail.load(std::memory_order_relaxed);
+    uint64_t abandoned = 0;
+    
+    while (true) {
+        LogRecord& rec = ring->slots[pos % LOG_RING_SLOTS];
+        uint64_t seq = rec.seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(seq - (pos + 1));
+        
+        if (diff < 0) {
+            if (ring->head.load(std::memory_order_relaxed) <= pos) break;
+            
+            uint64_t now = monotonic_ns();
+            if (ring_stuck_pos != pos) {
+                ring_stuck_pos = pos;
+                ring_stuck_since = now;
+                break;
+            }
+            if (now - ring_stuck_since < LOG_RING_STUCK_NS) break;
+            if (!ring->tail.compare_exchange_strong(pos, pos + 1, std::memory_order_relaxed)) continue;
+            
+            // Слот сразу отдается следующему кругу; если писатель жив, его
+            // публикация (CAS с pos) не пройдет, и он сочтет запись потерянной.
+            uint64_t expected = pos;
+            if (rec.seq.compare_exchange_strong(expected, pos + LOG_RING_SLOTS, std::memory_order_acq_rel)) {
+                abandoned++;
+                pos++;
+                continue;
+            }
+            // Писатель успел опубликовать: запись читается как обычно.
+        } else if (diff > 0) {
+            pos = ring->tail.load(std::memory_order_relaxed);
+            continue;
+        } else if (!ring->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+            continue;
+        }
+        
+        if (rec.length & LOG_RECORD_BINARY) {
+            binary.append(rec.text, rec.length & ~LOG_RECORD_BINARY);
+        } else {
+            batch.emplace_back(rec.text, rec.length);
+            batch.back() += '\n';
+        }
+        rec.seq.store(pos + LOG_RING_SLOTS, std::memory_order_release);
+        pos++;
+    }
+    
+    if (abandoned > 0) {
+        char note[128];
+        snprintf(note, sizeof(note), "PID=%lld WARNING: shared log ring slot not published by writer, %llu lines lost\n",
+                (long long)get_current_pid(), (unsigned long long)abandoned);
+        batch.emplace_back(note);
+    }
+    uint64_t lost = ring->overflow.exchange(0);
+    if (lost > 0) {
+        char note[128];
+        snprintf(note, sizeof(note), "PID=%lld WARNING: shared log ring overflow, %llu lines dropped\n",
+                (long long)get_current_pid(), (unsigned long long)lost);
+        batch.emplace_back(note);
+    }
+}
+
+void AsyncLogger::write_batch(std::vector<std::string>& batch) {
+    size_t total = 0;
+    for (const std::string& line : batch) total += line.size();
+    
+    log_handle_t fd = output.acquire(total);
+    if (fd == LOG_HANDLE_NONE) return;
+    output.written(total);
+    
+#ifdef _WIN32
+    std::string joined;
+    joined.reserve(total);
+    for (const std::string& line : batch) joined += line;
+    DWORD bytes_written;
+    WriteFile(fd, joined.data(), (DWORD)joined.size(), &bytes_written, NULL);
+#else
+    if (uring.available() && total <= uring.buffer_size()) {
+        char* dst = uring.buffer(LOG_IO_TEXT);
+        for (const std::string& line : batch) {
+            memcpy(dst, line.data(), line.size());
+            dst += line.size();
+        }
+        if (queue_uring_write(LOG_IO_TEXT, output, fd, total)) return;
+    }
+    
+    std::vector<struct iovec> iov;
+    iov.reserve(config.max_batch);
+    
+    size_t next = 0;
+    while (next < batch.size()) {
+        iov.clear();
+        while (next < batch.size() && iov.size() < config.max_batch) {
+            iov.push_back({ (void*)batch[next].data(), batch[next].size() });
+            next++;
+        }
+        
+        struct iovec* cur = iov.data();
+        int count = (int)iov.size();
+        while (count > 0) {
+            sync_syscalls.fetch_add(1, std::memory_order_relaxed);
+            ssize_t n = writev(fd, cur, count);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            while (count > 0 && (size_t)n >= cur->iov_len) {
+                n -= cur->iov_len;
+                cur++;
+                count--;
+            }
+            if (count > 0) {
+                cur->iov_base = (char*)cur->iov_base + n;
+                cur->iov_len -= n;
+            }
+        }
+    }
+    if (config.fsync) {
+        sync_syscalls.fetch_add(1, std::memory_order_relaxed);
+        fdatasync(fd);
+    }
+#endif
+}
+
+void AsyncLogger::write_binary(const std::string& records) {
+    log_handle_t fd = binary_output.acquire(records.size());
+    if (fd == LOG_HANDLE_NONE) return;
+    binary_output.written(records.size());
+    
+#ifndef _WIN32
+    if (uring.available() && records.size() <= uring.buffer_size()) {
+        memcpy(uring.buffer(LOG_IO_BINARY), records.data(), records.size());
+        if (queue_uring_write(LOG_IO_BINARY, binary_output, fd, records.size())) return;
+    }
+#endif
+    write_sync(fd, records.data(), records.size());
+}
+
+void AsyncLogger::write_sync(log_handle_t fd, const char* data, size_t size) {
+#ifdef _WIN32
+    DWORD bytes_written;
+    WriteFile(fd, data, (DWORD)size, &bytes_written, NULL);
+    if (config.fsync) FlushFileBuffers(fd);
+#else
+    while (size > 0) {
+        sync_syscalls.fetch_add(1, std::memory_order_relaxed);
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    if (config.fsync) {
+        sync_syscalls.fetch_add(1, std::memory_order_relaxed);
+        fdatasync(fd);
+    }
+#endif
+}
+
+// Данные уже лежат в буфере tag. Дескриптор регистрируется заново после
+// каждого открытия файла: номер после ротации обычно тот же, а файл другой.
+bool AsyncLogger::queue_uring_write(int tag, const LogSegmentWriter& out, log_handle_t fd, size_t size) {
+    if (uring_generation[tag] != out.generation()) {
+        uring.set_file(tag, (int)(intptr_t)fd);
+        uring_generation[tag] = out.generation();
+    }
+    if (!uring.queue_write(tag, tag, size, (uint64_t)-1, config.fsync, tag)) return false;
+    uring_handle[tag] = fd;
+    uring_length[tag] = size;
+    return true;
+}
+
+// Дожидается отправленных записей io_uring, прежде чем буферы и файлы
+// понадобятся снова; недописанный остаток пишется синхронно.
+void AsyncLogger::finish_uring_writes() {
+    uring.complete();
+    for (int tag = LOG_IO_TEXT; tag <= LOG_IO_BINARY; tag++) {
+        if (uring_length[tag] == 0) continue;
+        int res = uring.result(tag);
+        if (res >= 0 && (size_t)res < uring_length[tag]) {
+            write_sync(uring_handle[tag], uring.buffer(tag) + res, uring_length[tag] - res);
+        }
+        uring_length[tag] = 0;
+    }
+}
+
+static void log_message_sync(const char* message) {
+#ifdef _WIN32
+    HANDLE hFile = CreateFileA(log_filename(), 
+                              FILE_APPEND_DATA, 
+                              FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL,
+                              OPEN_ALWAYS,
+                              FILE_ATTRIBUTE_NORMAL,
+                              NULL);
+    
+    if (hFile == INVALID_HANDLE_VALUE) return;
+    
+    DWORD bytes_written;
+    std::string msg_str = std::string(message) + "\n";
+    WriteFile(hFile, msg_str.c_str(), (DWORD)msg_str.length(), &bytes_written, NULL);
+    CloseHandle(hFile);
+#else
+    int fd = open(log_filename(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd == -1) return;
+    
+    struct iovec iov[2] = {
+        { (void*)message, strlen(message) },
+        { (void*)"\n", 1 }
+    };
+    ssize_t written = writev(fd, iov, 2);
+    (void)written;
+    close(fd);
+#endif
+}
+
+static bool log_ring_push(LogRing* ring, const char* data, size_t len, uint32_t flags) {
+    uint64_t pos = ring->head.load(std::memory_order_relaxed);
+    
+    while (true) {
+        LogRecord& rec = ring->slots[pos % LOG_RING_SLOTS];
+        uint64_t seq = rec.seq.load(std::memory_order_acquire);
+        int64_t diff = (int64_t)(seq - pos);
+        
+        if (diff == 0) {
+            if (ring->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                if (len > sizeof(rec.text)) len = sizeof(rec.text);
+                memcpy(rec.text, data, len);
+                rec.length = (uint32_t)len | flags;
+                // Не проходит, только если выгружающий уже пропустил слот.
+                uint64_t reserved = pos;
+                return rec.seq.compare_exchange_strong(reserved, pos + 1, std::memory_order_release,
+                                                       std::memory_order_relaxed);
+            }
+        } else if (diff < 0) {
+            ring->overflow.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            pos = ring->head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static AsyncLogger* get_logger() {
+    if (!g_logger) {
+        g_logger = new AsyncLogger(log_filename(), logger_config_from_env());
+    }
+    return g_logger;
+}
+
+void log_message(const char* message) {
+    if (g_sync.load(std::memory_order_relaxed)) {
+        log_message_sync(message);
+        return;
+    }
+    
+    LogRing* ring = g_ring.load(std::memory_order_acquire);
+    if (ring) {
+        log_ring_push(ring, message, strlen(message), 0);
+        return;
+    }
+    
+    std::lock_guard<std::mutex> guard(g_logger_mutex);
+    
+    if (g_logger_closed) {
+        log_message_sync(message);
+        return;
+    }
+    
+    get_logger()->enqueue(message);
+}
+
+// Двоичная запись возможна только через общий LogRing; без него (до
+// подключения к памяти, после log_shutdown или в режиме log_set_sync)
+// событие пишется текстом.
+void log_event(LogEventType type, int role, int64_t value, int64_t arg, int aux) {
+    LogEvent ev;
+    ev.value = value;
+    ev.arg = arg;
+    ev.pid = (int32_t)get_current_pid();
+    ev.type = (uint8_t)type;
+    ev.role = (uint8_t)role;
+    ev.aux = (int16_t)aux;
+    
+    LogRing* ring = g_ring.load(std::memory_order_acquire);
+    if (ring && log_binary_enabled() && !g_sync.load(std::memory_order_relaxed)) {
+        ev.ts_ns = realtime_ns();
+        log_ring_push(ring, (const char*)&ev, sizeof(ev), LOG_RECORD_BINARY);
+        return;
+    }
+    
+    char ts[TIMESTAMP_SIZE];
+    format_current_timestamp(ts, sizeof(ts));
+    char line[256];
+    log_event_format(ev, ts, line, sizeof(line));
+    log_message(line);
+}
+
+void log_attach_ring(LogRing* ring) {
+    g_ring.store(ring, std::memory_order_release);
+}
+
+// AsyncLogger с файлами и потоком записи нужен только выгружающему
+// процессу: остальные лишь кладут записи в LogRing. Ставший ведомым
+// процесс дописывает свою очередь и закрывает файлы.
+void log_set_drainer(bool enabled) {
+    std::lock_guard<std::mutex> guard(g_logger_mutex);
+    if (g_logger_closed) return;
+    if (enabled) {
+        get_logger()->set_drain_ring(g_ring.load());
+    } else {
+        delete g_logger;
+        g_logger = nullptr;
+    }
+}
+
+void log_set_sync(bool enabled) {
+    std::lock_guard<std::mutex> guard(g_logger_mutex);
+    g_sync.store(enabled, std::memory_order_relaxed);
+    // Уже поставленные в очередь строки уходят раньше синхронных.
+    if (enabled && g_logger) g_logger->flush();
+}
+
+void log_flush() {
+    std::lock_guard<std::mutex> guard(g_logger_mutex);
+    if (g_logger) g_logger->flush();
+}
+
+void log_shutdown() {
+    std::lock_guard<std::mutex> guard(g_logger_mutex);
+    delete g_logger;
+    g_logger = nullptr;
+    g_logger_closed = true;
+    g_ring.store(nullptr, std::memory_order_release);
+}
@@ -0,0 +1,102 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include "platform.h"
+#include "log_segments.h"
+#include "log_events.h"
+#include "io_ring.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+
+// Если процесс подключен к разделяемой памяти, log_message() только кладет
+// запись в LogRing, а файл открывает и пишет лишь процесс-лидер
+// (log_set_drainer): AsyncLogger создается только у него. Локальная
+// очередь используется до подключения.
+//
+// Параметры берутся из окружения, поэтому дочерние процессы наследуют их:
+//   COUNTER_LOG_FILE     - имя файла лога (counter_log.txt)
+//   COUNTER_LOG_FLUSH_MS - максимальная задержка записи пачки (мс)
+//   COUNTER_LOG_BATCH    - максимальное число строк в одном writev
+//   COUNTER_LOG_QUEUE    - емкость очереди; при переполнении строки
+//                          отбрасываются и учитываются в счетчике
+//   COUNTER_LOG_FSYNC    - fdatasync после записи каждой пачки (0)
+//   COUNTER_IO_URING     - писать пачки через io_uring (1): запись и
+//                          fdatasync уходят одним io_uring_enter, поток
+//                          записи не ждет их завершения до следующей
+//                          пачки или flush(); без io_uring - writev
+// Ротация и хранение сегментов файла - см. log_segments.h.
+struct LoggerConfig {
+    int flush_interval_ms;
+    size_t max_batch;
+    size_t queue_capacity;
+    bool fsync;
+    bool io_uring;
+    LogSegmentConfig segments;
+};
+
+// Число записанных пачек (проходов потока записи с данными) и системных
+// вызовов ввода-вывода на них, включая ожидание завершений io_uring.
+struct LogIoStats {
+    bool io_uring;
+    uint64_t batches;
+    uint64_t syscalls;
+};
+
+LoggerConfig logger_config_from_env();
+
+// Синхронный режим: log_message() и log_event() сами пишут каждую строку
+// в файл (open/write/close) в вызывающем процессе, минуя LogRing и очередь
+// AsyncLogger; выгрузка кольца лидером при этом продолжается.
+void log_set_sync(bool enabled);
+
+// Событие лога (см. log_events.h); pid и время заполняются здесь.
+void log_event(LogEventType type, int role, int64_t value, int64_t arg = 0, int aux = 0);
+
+class AsyncLogger {
+private:
+    LoggerConfig config;
+    LogSegmentWriter output;
+    LogSegmentWriter binary_output;
+    LogRing* drain_ring;
+    uint64_t ring_stuck_pos;      // зарезервированный, но не опубликованный слот
+    uint64_t ring_stuck_since;
+    std::vector<std::string> pending;
+    std::vector<std::string> writing;
+    std::string binary_writing;
+    uint64_t dropped;
+    bool stopping;
+    bool flush_requested;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::condition_variable flushed_cv;
+    uint64_t passes_started;
+    uint64_t passes_done;
+    IoRing uring;
+    uint64_t uring_generation[2];
+    log_handle_t uring_handle[2];
+    size_t uring_length[2];
+    std::atomic<uint64_t> io_batches;
+    std::atomic<uint64_t> sync_syscalls;
+    std::thread writer;
+    
+    void writer_loop();
+    void drain_ring_into(LogRing* ring, std::vector<std::string>& batch, std::string& binary);
+    void write_batch(std::vector<std::string>& batch);
+    void write_binary(const std::string& records);
+    void write_sync(log_handle_t fd, const char* data, size_t size);
+    bool queue_uring_write(int tag, const LogSegmentWriter& out, log_handle_t fd, size_t size);
+    void finish_uring_writes();
+    
+public:
+    AsyncLogger(const char* filename, const LoggerConfig& cfg);
+    ~AsyncLogger();
+    void enqueue(const char* message);
+    void flush();
+    void set_drain_ring(LogRing* ring);
+    LogIoStats io_stats() const;
+};
+
+#endif
@@ -1,141 +1,339 @@
 #include "platform.h"
+#include "logger.h"
+#include "counter.h"
+#include "registry.h"
+#include "pool.h"
+#include "event_loop.h"
+#include "supervisor.h"
+#include "persist.h"
+#include "control.h"
+#include "participants.h"
+#include "trace.h"
+#include "counter_policy.h"
 #include <iostream>
-#include <thread>
 #include <atomic>
 #include <csignal>
 #include <sstream>
+#include <thread>
+#include <vector>
+
+#ifndef COUNTER_POLICY_LOCK
+#define COUNTER_POLICY_LOCK AtomicLock
+#define COUNTER_POLICY_STORAGE FileStorage
+#define COUNTER_POLICY_LOG RingLog
+#endif
 
-std::atomic<bool> running{true};
+typedef Counter<COUNTER_POLICY_LOCK, COUNTER_POLICY_STORAGE, COUNTER_POLICY_LOG> MainCounter;
+
+MainCounter* counter = nullptr;
 SharedMemory* shared_mem = nullptr;
 Mutex* global_mutex = nullptr;
 LeaderElection* leader_election = nullptr;
+CounterRegistry* counter_registry = nullptr;
+EventLoop* event_loop = nullptr;
+ChildSupervisor* supervisor = nullptr;
+Checkpointer* checkpointer = nullptr;
+ControlServer* control_server = nullptr;
+ParticipantSlot* my_slot = nullptr;
 std::atomic<int64_t> local_counter{0};
+int log_timer = -1;
+int spawn_timer = -1;
+int reap_timer = -1;
+bool pool_started = false;
+// Дети, запущенные этим лидером (или принятые от прежнего), по JobKind.
+platform_pid_t child_pids[JOB_KINDS] = {};
+// Потоки высокочастотного режима (COUNTER_PRODUCERS).
+std::vector<std::thread> producers;
+std::atomic<bool> producers_stop{false};
 
 #ifdef _WIN32
 BOOL WINAPI console_handler(DWORD signal) {
     if (signal == CTRL_C_EVENT || signal == CTRL_BREAK_EVENT) {
-        running = false;
         std::cout << "\nПолучен сигнал завершения. Завершаем работу...\n";
+        if (event_loop) event_loop->stop();
         return TRUE;
     }
     return FALSE;
 }
-#else
+#elif !defined(__linux__)
 void signal_handler(int signum) {
-    running = false;
-    std::cout << "\nПолучен сигнал завершения. Завершаем работу...\n";
+    if (event_loop) event_loop->stop();
 }
 #endif
 
-void increment_thread() {
-    while (running) {
-        sleep_ms(300);
+ParticipantTable* participants() {
+    return &shared_mem->segment()->participants;
+}
+
+void join_participants(ParticipantRole role) {
+    my_slot = participant_claim(participants(), get_current_pid(), role);
+    if (my_slot) return;
+    
+    char ts[TIMESTAMP_SIZE];
+    format_current_timestamp(ts, sizeof(ts));
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), 
+            "[%s] PID=%lld WARNING: participant table full, running unregistered",
+            ts,
+            (long long)get_current_pid());
+    log_message(buffer);
+}
+
+void count_op() {
+    if (my_slot) my_slot->ops.fetch_add(1, std::memory_order_relaxed);
+}
+
+void heartbeat_task() {
+    participant_heartbeat(my_slot);
+}
+
+void increment_task() {
+    counter->add(1);
+    metric_add(shared_mem->segment()->metrics.increments);
+    count_op();
+}
+
+void producer_loop() {
+    SharedSegment* seg = shared_mem->segment();
+    while (!producers_stop.load(std::memory_order_relaxed)) counter_increment(seg, 1);
+}
+
+void start_producers() {
+    int count = env_int("COUNTER_PRODUCERS", 0);
+    for (int i = 0; i < count; i++) producers.emplace_back(producer_loop);
+}
+
+void stop_producers() {
+    producers_stop = true;
+    for (std::thread& producer : producers) producer.join();
+    producers.clear();
+    counter_deltas_shutdown(shared_mem->segment());
+}
+
+void log_task() {
+    log_event(LOG_EV_COUNTER, ROLE_NONE, counter_read(shared_mem->segment()));
+}
+
+void log_still_running(ParticipantRole role, int64_t pid) {
+    metric_add(shared_mem->segment()->metrics.spawn_skips);
+    log_event(LOG_EV_SPAWN_SKIP, role, pid);
+}
+
+void log_child_exit(ParticipantRole role, platform_pid_t pid, int status, int64_t runtime_ms) {
+    log_event(LOG_EV_EXIT, role, pid, runtime_ms, status);
+}
+
+ParticipantRole job_role(JobKind kind) {
+    return kind == JOB_CHILD1 ? ROLE_CHILD1 : ROLE_CHILD2;
+}
+
+void child_exited(JobKind kind, platform_pid_t pid, int status, int64_t runtime_ms) {
+    if (child_pids[kind] == pid) child_pids[kind] = 0;
+    participant_record_exit(participants(), job_role(kind), pid, status, runtime_ms);
+    
+    MetricsPage& metrics = shared_mem->segment()->metrics;
+    metric_add(metrics.child_exits);
+    if (status != 0) metric_add(metrics.child_failures);
+    
+    log_child_exit(job_role(kind), pid, status, runtime_ms);
+}
+
+void supervise_child(JobKind kind, platform_pid_t pid) {
+    supervisor->watch(pid, [kind](platform_pid_t pid, int status, int64_t runtime_ms) {
+        child_exited(kind, pid, status, runtime_ms);
+    });
+    if (supervisor->watching(pid)) child_pids[kind] = pid;
+}
+
+// Новый лидер принимает под наблюдение детей прежнего лидера, найденных
+// в таблице участников; слоты тех, кого наблюдать нельзя, освобождаются.
+void adopt_children() {
+    ParticipantTable* table = participants();
+    
+    for (int i = 0; i < PARTICIPANT_SLOTS; i++) {
+        ParticipantSlot& slot = table->slots[i];
+        int64_t pid = slot.pid.load(std::memory_order_acquire);
+        uint32_t role = slot.role.load(std::memory_order_relaxed);
+        if (pid <= 0 || (role != ROLE_CHILD1 && role != ROLE_CHILD2)) continue;
+        if (supervisor->watching((platform_pid_t)pid)) continue;
         
-        global_mutex->lock();
-        SharedCounter* sc = shared_mem->get();
-        sc->value++;
-        local_counter = sc->value;
-        global_mutex->unlock();
+        supervise_child(role == ROLE_CHILD1 ? JOB_CHILD1 : JOB_CHILD2, (platform_pid_t)pid);
+        if (!supervisor->watching((platform_pid_t)pid)) participant_release(&slot, (platform_pid_t)pid);
     }
 }
 
-void log_thread() {
-    while (running) {
-        sleep_ms(1000);
+void log_participant_reaped(platform_pid_t pid, uint32_t role) {
+    log_event(LOG_EV_REAPED, (int)role, pid);
+}
+
+void reap_task() {
+    participant_reap(participants(), log_participant_reaped);
+}
+
+// Умерший рабочий (в том числе посреди задания) заменяется новым, пока
+// пул не остановлен, иначе пул со временем остался бы без рабочих.
+void watch_pool_worker(platform_pid_t worker) {
+    supervisor->watch(worker, [](platform_pid_t pid, int status, int64_t runtime_ms) {
+        participant_record_exit(participants(), ROLE_WORKER, pid, status, runtime_ms);
+        log_child_exit(ROLE_WORKER, pid, status, runtime_ms);
         
-        if (!leader_election->is_current_leader()) continue;
+        if (shared_mem->segment()->pool.shutdown.load()) return;
+        platform_pid_t replacement = start_child_process("--worker");
+        if (replacement != 0) watch_pool_worker(replacement);
+    });
+}
+
+void start_pool_workers(int count) {
+    std::vector<platform_pid_t> pids(count);
+    int started = pool_start_workers(&shared_mem->segment()->pool, count, pids.data());
+    
+    for (int i = 0; i < started; i++) watch_pool_worker(pids[i]);
+}
+
+// Возвращает число запущенных (или переданных пулу) заданий.
+int spawn_children() {
+    JobPool* pool = &shared_mem->segment()->pool;
+    bool should_spawn = true;
+    
+    if (pool_started) {
+        int64_t pid;
+        if (pool_busy(pool, JOB_CHILD1, &pid)) {
+            log_still_running(ROLE_CHILD1, pid);
+            should_spawn = false;
+        }
+        if (pool_busy(pool, JOB_CHILD2, &pid)) {
+            log_still_running(ROLE_CHILD2, pid);
+            should_spawn = false;
+        }
         
-        global_mutex->lock();
-        SharedCounter* sc = shared_mem->get();
-        int64_t current_value = sc->value;
-        global_mutex->unlock();
+        if (!should_spawn) return 0;
         
-        Timestamp ts = get_current_timestamp();
+        int submitted = pool_submit(pool, JOB_CHILD1) + pool_submit(pool, JOB_CHILD2);
+        metric_add(shared_mem->segment()->metrics.spawns, submitted);
+        return submitted;
+    }
+    
+    // Пока процесс под наблюдением, он жив: о завершении сообщает
+    // supervisor, поэтому проверять PID здесь не нужно.
+    platform_pid_t running1 = child_pids[JOB_CHILD1];
+    platform_pid_t running2 = child_pids[JOB_CHILD2];
+    
+    if (supervisor->watching(running1)) {
+        log_still_running(ROLE_CHILD1, running1);
+        should_spawn = false;
+    }
+    
+    if (supervisor->watching(running2)) {
+        log_still_running(ROLE_CHILD2, running2);
+        should_spawn = false;
+    }
+    
+    if (!should_spawn) return 0;
+    
+    pool_mark_requested(pool, JOB_CHILD1);
+    platform_pid_t pid1 = start_child_process("--child1");
+    
+    pool_mark_requested(pool, JOB_CHILD2);
+    platform_pid_t pid2 = start_child_process("--child2");
+    
+    metric_add(shared_mem->segment()->metrics.spawns, (pid1 != 0) + (pid2 != 0));
+    if (pid1 != 0) supervise_child(JOB_CHILD1, pid1);
+    if (pid2 != 0) supervise_child(JOB_CHILD2, pid2);
+    return (pid1 != 0) + (pid2 != 0);
+}
+
+void spawn_task() {
+    trace_begin(TRACE_SPAWN);
+    int started = spawn_children();
+    trace_end(TRACE_SPAWN, started);
+}
+
+void log_leader_event(LogEventType event) {
+    log_event(event, ROLE_NONE, 0, (int64_t)leader_election->epoch());
+}
+
+void set_leader_tasks(bool leader) {
+    log_set_drainer(leader);
+    if (my_slot) my_slot->role.store(leader ? ROLE_LEADER : ROLE_MAIN, std::memory_order_relaxed);
+    if (leader && !checkpointer) {
+        checkpointer = MainCounter::Storage::start_checkpoints(shared_mem->segment());
+    } else if (!leader) {
+        delete checkpointer;
+        checkpointer = nullptr;
+    }
+    if (leader && !pool_started) {
+        int pool_workers = pool_configured_workers();
+        if (pool_workers > 0) {
+            start_pool_workers(pool_workers);
+            pool_started = true;
+        }
+    }
+    if (leader) adopt_children();
+    event_loop->set_timer_armed(log_timer, leader);
+    event_loop->set_timer_armed(spawn_timer, leader);
+    event_loop->set_timer_armed(reap_timer, leader);
+    
+    if (!leader) {
+        control_server->stop();
+    } else if (control_server->start()) {
+        char ts[TIMESTAMP_SIZE];
+        format_current_timestamp(ts, sizeof(ts));
         char buffer[256];
         snprintf(buffer, sizeof(buffer), 
-                "[%s] PID=%lld COUNTER=%lld",
-                format_timestamp(ts).c_str(),
+                "[%s] PID=%lld CONTROL LISTEN %s",
+                ts,
                 (long long)get_current_pid(),
-                (long long)current_value);
+                control_socket_name());
         log_message(buffer);
     }
 }
 
-void spawn_children_thread() {
-    while (running) {
-        sleep_ms(3000);
-        
-        if (!leader_election->is_current_leader()) continue;
-        
-        bool should_spawn = true;
-        
-        global_mutex->lock();
-        SharedCounter* sc = shared_mem->get();
-        
-        if (sc->child1_pid != 0 && is_process_alive(sc->child1_pid)) {
-            Timestamp ts = get_current_timestamp();
-            char buffer[256];
-            snprintf(buffer, sizeof(buffer), 
-                    "[%s] PID=%lld WARNING: Child1 (PID=%lld) still running, skipping spawn",
-                    format_timestamp(ts).c_str(),
-                    (long long)get_current_pid(),
-                    (long long)sc->child1_pid);
-            log_message(buffer);
-            should_spawn = false;
-        }
-        
-        if (sc->child2_pid != 0 && is_process_alive(sc->child2_pid)) {
-            Timestamp ts = get_current_timestamp();
-            char buffer[256];
-            snprintf(buffer, sizeof(buffer), 
-                    "[%s] PID=%lld WARNING: Child2 (PID=%lld) still running, skipping spawn",
-                    format_timestamp(ts).c_str(),
-                    (long long)get_current_pid(),
-                    (long long)sc->child2_pid);
-            log_message(buffer);
-            should_spawn = false;
-        }
-        
-        if (should_spawn) {
-            platform_pid_t pid1 = start_child_process("--child1");
-            if (pid1 != 0) {
-                sc->child1_pid = pid1;
-                sc->child1_start_time = time(nullptr);
-            }
-            
-            platform_pid_t pid2 = start_child_process("--child2");
-            if (pid2 != 0) {
-                sc->child2_pid = pid2;
-                sc->child2_start_time = time(nullptr);
-            }
+void lease_task() {
+    if (leader_election->is_current_leader()) {
+        if (!leader_election->renew()) {
+            set_leader_tasks(false);
+            log_leader_event(LOG_EV_LEADER_LOST);
         }
-        
-        global_mutex->unlock();
+    } else if (leader_election->try_acquire()) {
+        log_leader_event(LOG_EV_LEADER_PROMOTED);
+        set_leader_tasks(true);
     }
 }
 
-void child1_logic() {
-    Timestamp start_ts = get_current_timestamp();
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), 
-            "[%s] CHILD1 START PID=%lld",
-            format_timestamp(start_ts).c_str(),
-            (long long)get_current_pid());
-    log_message(buffer);
+void child1_job() {
+    trace_begin(TRACE_CHILD1);
+    log_event(LOG_EV_START, ROLE_CHILD1, 0);
     
-    global_mutex->lock();
-    SharedCounter* sc = shared_mem->get();
-    sc->value += 10;
-    local_counter = sc->value;
-    global_mutex->unlock();
+    counter_add(shared_mem->segment(), 10);
+    metric_add(shared_mem->segment()->metrics.increments);
+    count_op();
+    local_counter = counter_read(shared_mem->segment());
     
-    Timestamp end_ts = get_current_timestamp();
-    snprintf(buffer, sizeof(buffer), 
-            "[%s] CHILD1 END PID=%lld COUNTER=%lld",
-            format_timestamp(end_ts).c_str(),
-            (long long)get_current_pid(),
-            (long long)local_counter.load());
-    log_message(buffer);
+    log_event(LOG_EV_END, ROLE_CHILD1, local_counter.load());
+    trace_end(TRACE_CHILD1, local_counter.load());
+}
+
+void child2_job() {
+    trace_begin(TRACE_CHILD2);
+    log_event(LOG_EV_START, ROLE_CHILD2, 0);
+    
+    CounterOp doubling = counter_op(OP_MUL, 2);
+    ScopedTransform doubled(shared_mem->segment(), global_mutex, &doubling, 1);
+    local_counter = doubled.value();
+    count_op();
+    
+    sleep_ms(2000);
+    
+    bool reverted = doubled.revert();
+    local_counter = counter_read(shared_mem->segment());
+    
+    log_event(LOG_EV_END, ROLE_CHILD2, local_counter.load(), 0, reverted ? 0 : 1);
+    trace_end(TRACE_CHILD2, local_counter.load());
+}
+
+void exit_child_process() {
+    participant_release(my_slot, get_current_pid());
+    log_shutdown();
     
 #ifdef _WIN32
     ExitProcess(0);
@@ -144,112 +342,297 @@ void child1_logic() {
 #endif
 }
 
+void child1_logic() {
+    join_participants(ROLE_CHILD1);
+    pool_record_dispatch(&shared_mem->segment()->pool, JOB_CHILD1);
+    child1_job();
+    exit_child_process();
+}
+
 void child2_logic() {
-    Timestamp start_ts = get_current_timestamp();
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), 
-            "[%s] CHILD2 START PID=%lld",
-            format_timestamp(start_ts).c_str(),
-            (long long)get_current_pid());
-    log_message(buffer);
+    join_participants(ROLE_CHILD2);
+    pool_record_dispatch(&shared_mem->segment()->pool, JOB_CHILD2);
+    child2_job();
+    exit_child_process();
+}
+
+void run_job(JobKind kind) {
+    if (kind == JOB_CHILD1) child1_job();
+    else if (kind == JOB_CHILD2) child2_job();
+}
+
+void worker_logic() {
+    join_participants(ROLE_WORKER);
+    log_event(LOG_EV_START, ROLE_WORKER, 0);
     
-    global_mutex->lock();
-    SharedCounter* sc = shared_mem->get();
-    sc->value *= 2;
-    local_counter = sc->value;
-    global_mutex->unlock();
+    pool_worker_loop(&shared_mem->segment()->pool, run_job, heartbeat_task);
     
-    sleep_ms(2000);
+    log_event(LOG_EV_END, ROLE_WORKER, 0);
+    exit_child_process();
+}
+
+bool named_counter_command(const std::string& cmd) {
+    std::istringstream args(cmd);
+    std::string verb, name, number;
+    args >> verb >> name;
+    if (name.empty()) return false;
     
-    global_mutex->lock();
-    sc = shared_mem->get();
-    sc->value /= 2;
-    local_counter = sc->value;
-    global_mutex->unlock();
+    bool has_number = static_cast<bool>(args >> number);
     
-    Timestamp end_ts = get_current_timestamp();
-    snprintf(buffer, sizeof(buffer), 
-            "[%s] CHILD2 END PID=%lld COUNTER=%lld",
-            format_timestamp(end_ts).c_str(),
-            (long long)get_current_pid(),
-            (long long)local_counter.load());
-    log_message(buffer);
+    if (verb == "get" && !has_number) {
+        int64_t value;
+        if (counter_registry->get(name.c_str(), &value)) {
+            std::cout << name << " = " << value << "\n";
+        } else {
+            std::cout << "Счетчик " << name << " не найден\n";
+        }
+        return true;
+    }
     
-#ifdef _WIN32
-    ExitProcess(0);
-#else
-    exit(0);
-#endif
+    if (verb == "inc" && !has_number) {
+        int64_t value;
+        if (counter_registry->add(name.c_str(), 1, &value)) {
+            std::cout << name << " = " << value << "\n";
+        } else {
+            std::cout << "Ошибка: не удалось создать счетчик " << name << "\n";
+        }
+        return true;
+    }
+    
+    if (verb == "set" && has_number) {
+        try {
+            int64_t new_value = std::stoll(number);
+            if (!counter_registry->set(name.c_str(), new_value)) {
+                std::cout << "Ошибка: не удалось создать счетчик " << name << "\n";
+                return true;
+            }
+            
+            std::cout << "Счетчик " << name << " установлен в " << new_value << "\n";
+            
+            char ts[TIMESTAMP_SIZE];
+            format_current_timestamp(ts, sizeof(ts));
+            char buffer[256];
+            snprintf(buffer, sizeof(buffer), 
+                    "[%s] PID=%lld MANUAL_SET %s=%lld",
+                    ts,
+                    (long long)get_current_pid(),
+                    name.c_str(),
+                    (long long)new_value);
+            log_message(buffer);
+        } catch (...) {
+            std::cout << "Ошибка: неверный формат числа\n";
+        }
+        return true;
+    }
+    
+    return false;
 }
 
-void command_loop() {
+void print_banner() {
     std::cout << "\n=== СЧЕТЧИК ЗАПУЩЕН ===\n";
     std::cout << "PID процесса: " << get_current_pid() << "\n";
     std::cout << "Режим: " << (leader_election->is_current_leader() ? "ЛИДЕР" : "УЧАСТНИК") << "\n";
     std::cout << "Доступные команды:\n";
     std::cout << "  set N   - установить значение счетчика N\n";
     std::cout << "  get     - показать текущее значение\n";
+    std::cout << "  get --exact - точное значение с дельтами высокочастотного режима\n";
+    std::cout << "  set NAME N - установить именованный счетчик NAME в N\n";
+    std::cout << "  get NAME   - показать именованный счетчик\n";
+    std::cout << "  inc NAME   - увеличить именованный счетчик на 1\n";
+    std::cout << "  stats   - статистика блокировки и задержки запуска дочерних заданий\n";
+    std::cout << "  ps      - участники группы: процессы, роли, пульс\n";
+    std::cout << "  trace   - состояние трассировки (COUNTER_TRACE=1)\n";
+    std::cout << "  trace dump FILE - выгрузить трассировку группы в JSON для Perfetto\n";
+    std::cout << "  period  - показать периоды задач\n";
+    std::cout << "  period TASK MS - изменить период задачи TASK\n";
     std::cout << "  exit    - завершить программу\n\n";
+    std::cout << "counter> " << std::flush;
+}
+
+bool period_command(const std::string& cmd) {
+    std::istringstream args(cmd);
+    std::string verb, name, number;
+    args >> verb;
+    if (verb != "period") return false;
     
-    while (running) {
-        std::cout << "counter> ";
-        std::string cmd;
-        std::getline(std::cin, cmd);
-        
-        if (cmd.empty()) continue;
-        
-        if (cmd == "exit") {
-            running = false;
-            break;
+    if (!(args >> name)) {
+        for (size_t i = 0; i < event_loop->timer_count(); i++) {
+            std::cout << "  " << event_loop->timer_name(i) << ": "
+                      << event_loop->timer_period(i) << " мс"
+                      << (event_loop->timer_armed(i) ? "" : " (не активна)") << "\n";
         }
+        return true;
+    }
+    
+    try {
+        if (!(args >> number)) throw std::invalid_argument(cmd);
+        int period_ms = std::stoi(number);
+        if (period_ms <= 0) throw std::out_of_range(cmd);
         
-        if (cmd == "get") {
-            std::cout << "Текущее значение счетчика: " << local_counter.load() << "\n";
-            continue;
+        if (!event_loop->set_timer_period(name, period_ms)) {
+            std::cout << "Задача " << name << " не найдена\n";
+            return true;
         }
+        std::cout << "Период задачи " << name << " установлен в " << period_ms << " мс\n";
+    } catch (...) {
+        std::cout << "Ошибка: неверный формат периода\n";
+    }
+    return true;
+}
+
+void print_participants() {
+    ParticipantTable* table = participants();
+    uint64_t now_ns = monotonic_ns();
+    time_t now = time(nullptr);
+    
+    std::cout << "  СЛОТ       PID  РОЛЬ     ВОЗРАСТ,с  ПУЛЬС,с  ОПЕРАЦИЙ\n";
+    for (int i = 0; i < PARTICIPANT_SLOTS; i++) {
+        ParticipantSlot& slot = table->slots[i];
+        int64_t pid = slot.pid.load(std::memory_order_acquire);
+        if (pid <= 0) continue;
         
-        if (cmd.substr(0, 4) == "set ") {
-            try {
-                int64_t new_value = std::stoll(cmd.substr(4));
-                
-                global_mutex->lock();
-                SharedCounter* sc = shared_mem->get();
-                sc->value = new_value;
-                local_counter = new_value;
-                global_mutex->unlock();
-                
-                std::cout << "Счетчик установлен в " << new_value << "\n";
-                
-                Timestamp ts = get_current_timestamp();
-                char buffer[256];
-                snprintf(buffer, sizeof(buffer), 
-                        "[%s] PID=%lld MANUAL_SET COUNTER=%lld",
-                        format_timestamp(ts).c_str(),
-                        (long long)get_current_pid(),
-                        (long long)new_value);
-                log_message(buffer);
-            } catch (...) {
-                std::cout << "Ошибка: неверный формат числа\n";
-            }
-            continue;
+        uint64_t heartbeat = slot.heartbeat_ns.load(std::memory_order_relaxed);
+        char line[128];
+        snprintf(line, sizeof(line), "  %4d  %8lld  %-7s  %9lld  %7.1f  %8llu%s%s\n",
+                 i,
+                 (long long)pid,
+                 participant_role_name(slot.role.load(std::memory_order_relaxed)),
+                 (long long)(now - slot.started.load(std::memory_order_relaxed)),
+                 now_ns > heartbeat ? (now_ns - heartbeat) / 1e9 : 0.0,
+                 (unsigned long long)slot.ops.load(std::memory_order_relaxed),
+                 pid == (int64_t)get_current_pid() ? "  *" : "",
+                 participant_stale(&slot, now_ns) ? "  нет пульса" : "");
+        std::cout << line;
+    }
+}
+
+bool trace_command(const std::string& cmd) {
+    std::istringstream args(cmd);
+    std::string verb, action, path;
+    args >> verb;
+    if (verb != "trace") return false;
+    
+    if (!(args >> action)) {
+        int rings;
+        uint64_t events;
+        trace_usage(&rings, &events);
+        std::cout << "Трассировка этого процесса " << (trace_ring ? "включена" : "выключена")
+                  << "; колец в сегменте: " << rings << ", событий: " << events << "\n";
+        return true;
+    }
+    
+    if (action != "dump" || !(args >> path)) {
+        std::cout << "Использование: trace [dump FILE]\n";
+        return true;
+    }
+    
+    long written = trace_dump(path.c_str());
+    if (written < 0) {
+        std::cout << "Ошибка: нет сегмента трассировки (нужен запуск с COUNTER_TRACE=1) или не удалось записать "
+                  << path << "\n";
+    } else {
+        std::cout << "Записано событий: " << written << " в " << path << "\n";
+    }
+    return true;
+}
+
+// Без stdin (перенаправлен из файла или закрыт) процесс продолжает работу
+// как участник группы; завершить его можно сигналом.
+void stdin_closed() {
+    std::cout << "stdin закрыт: команды недоступны, завершение по SIGINT/SIGTERM\n";
+}
+
+void handle_command(const std::string& cmd) {
+    if (cmd == "exit") {
+        event_loop->stop();
+        return;
+    }
+    
+    if (cmd == "stats") {
+#ifdef COUNTER_LOCK_STATS
+        lock_stats_print(&shared_mem->segment()->lock_stats);
+#else
+        std::cout << "Статистика блокировок не собрана (нужна сборка с -DCOUNTER_LOCK_STATS)\n";
+#endif
+        LatencyHistogram& dispatch = shared_mem->segment()->pool.dispatch;
+        std::cout << "Задержка запуска child1/child2 p50/p99/max: "
+                  << dispatch.percentile(0.5) << " / " << dispatch.percentile(0.99) << " / "
+                  << dispatch.percentile(1.0) << " нс (запусков: " << dispatch.total() << ")\n";
+        
+        DeltaSummary deltas;
+        counter_delta_summary(shared_mem->segment(), &deltas);
+        if (deltas.calls > 0) {
+            std::cout << "Высокочастотный режим: вызовов " << deltas.calls << ", переносов " << deltas.flushes
+                      << " (" << (deltas.flushes ? deltas.calls / deltas.flushes : 0) << " на перенос), в слотах "
+                      << deltas.pending << " (" << deltas.slots << " слотов); отставание p50/p99/max: "
+                      << deltas.staleness_p50 << " / " << deltas.staleness_p99 << " / "
+                      << deltas.staleness_max << " нс\n";
         }
         
-        std::cout << "Неизвестная команда. Доступные: set N, get, exit\n";
+        CounterSnapshot snap;
+        counter_snapshot(shared_mem->segment(), &snap);
+        RoleStats* roles = participants()->roles;
+        std::cout << "Последнее завершение child1: код " << roles[ROLE_CHILD1].last_exit_status << ", "
+                  << roles[ROLE_CHILD1].last_runtime_ms << " мс; child2: код "
+                  << roles[ROLE_CHILD2].last_exit_status << ", " << roles[ROLE_CHILD2].last_runtime_ms
+                  << " мс (завершений: " << roles[ROLE_CHILD1].exits << " / " << roles[ROLE_CHILD2].exits
+                  << ", рабочих пула: " << roles[ROLE_WORKER].exits << ")\n";
+        if (checkpointer) {
+            std::cout << "Контрольные точки p50/p99/max: " << checkpointer->cost.percentile(0.5) << " / "
+                      << checkpointer->cost.percentile(0.99) << " / " << checkpointer->cost.percentile(1.0)
+                      << " нс (записано: " << checkpointer->cost.total()
+                      << ", пропущено без изменений: " << checkpointer->skipped.load() << ")\n";
+        }
+        if (control_server->listening()) {
+            std::cout << "Управляющий сокет " << control_socket_name() << ": клиентов "
+                      << control_server->client_count() << ", команд " << control_server->request_count() << "\n";
+        }
+        std::cout << "Лидер: PID " << snap.leader_pid << ", активность "
+                  << (long long)(time(nullptr) - snap.last_leader_activity) << " с назад"
+                  << (snap.consistent ? "" : " (снимок несогласован: запись не завершена)") << "\n";
+    } else if (cmd == "ps") {
+        print_participants();
+    } else if (trace_command(cmd)) {
+    } else if (cmd == "get") {
+        std::cout << "Текущее значение счетчика: " << counter->get() << "\n";
+    } else if (cmd == "get --exact") {
+        std::cout << "Точное значение счетчика: " << counter_read_exact(shared_mem->segment()) << "\n";
+    } else if (period_command(cmd) || named_counter_command(cmd)) {
+    } else if (cmd.substr(0, 4) == "set ") {
+        try {
+            int64_t new_value = std::stoll(cmd.substr(4));
+            
+            counter->set(new_value);
+            metric_add(shared_mem->segment()->metrics.sets);
+            
+            std::cout << "Счетчик установлен в " << new_value << "\n";
+        } catch (...) {
+            std::cout << "Ошибка: неверный формат числа\n";
+        }
+    } else if (!cmd.empty()) {
+        std::cout << "Неизвестная команда. Доступные: set N, get, get --exact, set NAME N, get NAME, inc NAME, stats, ps, trace, period, exit\n";
     }
+    
+    std::cout << "counter> " << std::flush;
 }
 
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
     SetConsoleCtrlHandler((PHANDLER_ROUTINE)console_handler, TRUE);
+#elif defined(__linux__)
+    block_shutdown_signals();
 #else
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
     signal(SIGHUP, signal_handler);
 #endif
     
-    shared_mem = new SharedMemory();
-    global_mutex = new Mutex();
-    leader_election = new LeaderElection();
+    counter = new MainCounter(SHM_NAME);
+    shared_mem = &counter->memory();
+    global_mutex = &counter->mutex();
+    trace_attach(argc > 1 && strncmp(argv[1], "--", 2) == 0 ? argv[1] + 2 : "main");
+    CheckpointRecord restored;
+    if (MainCounter::Storage::restored(&restored)) checkpoint_log_restored(restored);
     
     if (argc > 1) {
         if (strcmp(argv[1], "--child1") == 0) {
@@ -258,50 +641,54 @@ int main(int argc, char* argv[]) {
         } else if (strcmp(argv[1], "--child2") == 0) {
             child2_logic();
             return 0;
+        } else if (strcmp(argv[1], "--worker") == 0) {
+            worker_logic();
+            return 0;
         }
     }
     
-    Timestamp start_ts = get_current_timestamp();
-    char buffer[256];
-    snprintf(buffer, sizeof(buffer), 
-            "[%s] MAIN START PID=%lld (Leader: %s)",
-            format_timestamp(start_ts).c_str(),
-            (long long)get_current_pid(),
-            leader_election->is_current_leader() ? "YES" : "NO");
-    log_message(buffer);
+    leader_election = new LeaderElection(shared_mem);
+    join_participants(leader_election->is_current_leader() ? ROLE_LEADER : ROLE_MAIN);
+    counter_registry = new CounterRegistry(global_mutex);
+    event_loop = new EventLoop();
+    supervisor = new ChildSupervisor(event_loop);
+    control_server = new ControlServer(event_loop, shared_mem, global_mutex, counter_registry);
     
-    global_mutex->lock();
-    SharedCounter* sc = shared_mem->get();
-    local_counter = sc->value;
-    global_mutex->unlock();
+    log_event(LOG_EV_MAIN_START, ROLE_NONE, 0, 0, leader_election->is_current_leader() ? 1 : 0);
     
-    std::thread inc_thread(increment_thread);
-    std::thread log_thr;
-    std::thread spawn_thr;
+    event_loop->add_timer("increment", 300, true, increment_task);
+    event_loop->add_timer("lease", leader_election->renew_interval_ms(), true, lease_task);
+    log_timer = event_loop->add_timer("log", 1000, false, log_task);
+    spawn_timer = event_loop->add_timer("spawn", 3000, false, spawn_task);
+    event_loop->add_timer("heartbeat", 1000, true, heartbeat_task);
+    reap_timer = event_loop->add_timer("participants", 1000, false, reap_task);
     
     if (leader_election->is_current_leader()) {
-        log_thr = std::thread(log_thread);
-        spawn_thr = std::thread(spawn_children_thread);
+        set_leader_tasks(true);
     }
     
-    command_loop();
+    event_loop->watch_shutdown_signals();
+    event_loop->watch_stdin(handle_command, stdin_closed);
     
-    running = false;
-    if (inc_thread.joinable()) inc_thread.join();
-    if (log_thr.joinable()) log_thr.join();
-    if (spawn_thr.joinable()) spawn_thr.join();
+    print_banner();
+    start_producers();
+    event_loop->run();
     
-    delete leader_election;
-    delete global_mutex;
-    delete shared_mem;
+    stop_producers();
+    if (pool_started) pool_shutdown(&shared_mem->segment()->pool);
+    if (checkpointer && leader_election->is_current_leader()) checkpointer->finish();
+    delete checkpointer;
+    participant_release(my_slot, get_current_pid());
     
-    Timestamp end_ts = get_current_timestamp();
-    snprintf(buffer, sizeof(buffer), 
-            "[%s] MAIN EXIT PID=%lld COUNTER=%lld",
-            format_timestamp(end_ts).c_str(),
-            (long long)get_current_pid(),
-            (long long)local_counter.load());
-    log_message(buffer);
+    log_event(LOG_EV_MAIN_EXIT, ROLE_NONE, counter_read(shared_mem->segment()));
+    log_shutdown();
+    
+    delete control_server;
+    delete supervisor;
+    delete event_loop;
+    delete counter_registry;
+    delete leader_election;
+    delete counter;
     
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,80 @@
+#include "participants.h"
+#include "stats.h"
+
+ParticipantSlot* participant_claim(ParticipantTable* table, platform_pid_t pid, ParticipantRole role) {
+    uint32_t start = (uint32_t)pid % PARTICIPANT_SLOTS;
+    
+    for (uint32_t i = 0; i < PARTICIPANT_SLOTS; i++) {
+        ParticipantSlot& slot = table->slots[(start + i) % PARTICIPANT_SLOTS];
+        int64_t free_pid = 0;
+        if (slot.pid.load(std::memory_order_relaxed) != 0 ||
+            !slot.pid.compare_exchange_strong(free_pid, -(int64_t)pid)) {
+            continue;
+        }
+        
+        slot.role.store(role, std::memory_order_relaxed);
+        slot.started.store(time(nullptr), std::memory_order_relaxed);
+        slot.heartbeat_ns.store(monotonic_ns(), std::memory_order_relaxed);
+        slot.ops.store(0, std::memory_order_relaxed);
+        slot.pid.store((int64_t)pid, std::memory_order_release);
+        return &slot;
+    }
+    return nullptr;
+}
+
+ParticipantSlot* participant_find(ParticipantTable* table, platform_pid_t pid) {
+    uint32_t start = (uint32_t)pid % PARTICIPANT_SLOTS;
+    
+    for (uint32_t i = 0; i < PARTICIPANT_SLOTS; i++) {
+        ParticipantSlot& slot = table->slots[(start + i) % PARTICIPANT_SLOTS];
+        if (slot.pid.load(std::memory_order_acquire) == (int64_t)pid) return &slot;
+    }
+    return nullptr;
+}
+
+void participant_release(ParticipantSlot* slot, platform_pid_t pid) {
+    if (!slot) return;
+    int64_t owner = (int64_t)pid;
+    slot->pid.compare_exchange_strong(owner, 0);
+}
+
+void participant_heartbeat(ParticipantSlot* slot) {
+    if (slot) slot->heartbeat_ns.store(monotonic_ns(), std::memory_order_relaxed);
+}
+
+bool participant_stale(const ParticipantSlot* slot, uint64_t now_ns) {
+    uint32_t role = slot->role.load(std::memory_order_relaxed);
+    if (role != ROLE_MAIN && role != ROLE_LEADER && role != ROLE_WORKER) return false;
+    
+    uint64_t heartbeat = slot->heartbeat_ns.load(std::memory_order_relaxed);
+    return now_ns > heartbeat && now_ns - heartbeat > PARTICIPANT_STALE_MS * 1000000ull;
+}
+
+void participant_record_exit(ParticipantTable* table, ParticipantRole role, platform_pid_t pid,
+                             int status, int64_t runtime_ms) {
+    RoleStats& stats = table->roles[role];
+    stats.last_exit_status.store(status, std::memory_order_relaxed);
+    stats.last_runtime_ms.store(runtime_ms, std::memory_order_relaxed);
+    stats.exits.fetch_add(1, std::memory_order_relaxed);
+    
+    participant_release(participant_find(table, pid), pid);
+}
+
+int participant_reap(ParticipantTable* table,
+                     void (*on_reaped)(platform_pid_t pid, uint32_t role)) {
+    int reaped = 0;
+    
+    for (int i = 0; i < PARTICIPANT_SLOTS; i++) {
+        ParticipantSlot& slot = table->slots[i];
+        int64_t pid = slot.pid.load(std::memory_order_acquire);
+        int64_t owner = pid < 0 ? -pid : pid;
+        if (pid == 0 || is_process_alive((platform_pid_t)owner)) continue;
+        
+        uint32_t role = slot.role.load(std::memory_order_relaxed);
+        if (!slot.pid.compare_exchange_strong(pid, 0)) continue;
+        
+        reaped++;
+        if (on_reaped && pid > 0) on_reaped((platform_pid_t)pid, role);
+    }
+    return reaped;
+}
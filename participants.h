@@ -0,0 +1,32 @@
+#ifndef PARTICIPANTS_H
+#define PARTICIPANTS_H
+
+#include "platform.h"
+
+// Операции над ParticipantTable (см. segment.h). Поиск - линейный проход
+// по слотам без блокировок; занятие и освобождение - CAS по pid.
+
+// Главные процессы и рабочие пула отмечают пульс не реже раза в секунду.
+// Живой участник без пульса дольше этого срока считается зависшим: его
+// слот не освобождается (процесс может продолжить работу), но
+// participant_stale и ps его показывают.
+#define PARTICIPANT_STALE_MS 10000
+
+ParticipantSlot* participant_claim(ParticipantTable* table, platform_pid_t pid, ParticipantRole role);
+ParticipantSlot* participant_find(ParticipantTable* table, platform_pid_t pid);
+void participant_release(ParticipantSlot* slot, platform_pid_t pid);
+void participant_heartbeat(ParticipantSlot* slot);
+bool participant_stale(const ParticipantSlot* slot, uint64_t now_ns);
+
+// Учитывает завершение процесса в RoleStats и освобождает его слот, если
+// процесс не успел сделать это сам.
+void participant_record_exit(ParticipantTable* table, ParticipantRole role, platform_pid_t pid,
+                             int status, int64_t runtime_ms);
+
+// Освобождает слоты умерших процессов, включая слоты, которые процесс
+// начал занимать и не заполнил; вызывается лидером по таймеру. Для
+// каждого освобожденного заполненного слота вызывает on_reaped (если задан).
+int participant_reap(ParticipantTable* table,
+                     void (*on_reaped)(platform_pid_t pid, uint32_t role));
+
+#endif
@@ -0,0 +1,215 @@
+#include "persist.h"
+#include "counter.h"
+#include <chrono>
+#include <cstddef>
+
+static uint64_t record_checksum(const CheckpointRecord& record) {
+    const unsigned char* bytes = (const unsigned char*)&record;
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < offsetof(CheckpointRecord, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+static bool record_valid(const CheckpointRecord& record) {
+    return record.magic == CHECKPOINT_MAGIC && record.checksum == record_checksum(record);
+}
+
+static int64_t unix_time_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* checkpoint_path() {
+    const char* path = getenv("COUNTER_PERSIST");
+    return path && *path ? path : nullptr;
+}
+
+bool checkpoint_recover(CheckpointRecord* out) {
+    const char* path = checkpoint_path();
+    if (!path) return false;
+    
+    CheckpointFile file(path);
+    return file.load(out);
+}
+
+void checkpoint_log_restored(const CheckpointRecord& record) {
+    char ts[TIMESTAMP_SIZE];
+    format_current_timestamp(ts, sizeof(ts));
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), 
+            "[%s] PID=%lld CHECKPOINT RESTORED VALUE=%lld SEQ=%llu",
+            ts,
+            (long long)get_current_pid(),
+            (long long)record.value,
+            (unsigned long long)record.seq);
+    log_message(buffer);
+}
+
+CheckpointFile::CheckpointFile(const char* path) : base(nullptr), last_seq(0), sync_syscalls(0) {
+    size_t size = 2 * CHECKPOINT_PAGE;
+    
+#ifdef _WIN32
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Ошибка открытия файла контрольных точек %s: %lu\n", path, GetLastError());
+        exit(1);
+    }
+    
+    mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, (DWORD)size, NULL);
+    if (mapping != NULL) base = (char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!base) {
+        fprintf(stderr, "Ошибка отображения файла контрольных точек: %lu\n", GetLastError());
+        exit(1);
+    }
+#else
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        perror(path);
+        exit(1);
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size < (off_t)size && ftruncate(fd, size) == -1) {
+        perror("ftruncate");
+        exit(1);
+    }
+    
+    base = (char*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    
+    if (ring.setup(2, 1, CHECKPOINT_PAGE, 1)) ring.set_file(0, fd);
+#endif
+    
+    CheckpointRecord record;
+    if (load(&record)) last_seq = record.seq;
+}
+
+CheckpointFile::~CheckpointFile() {
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle(mapping);
+    CloseHandle(file);
+#else
+    munmap(base, 2 * CHECKPOINT_PAGE);
+    close(fd);
+#endif
+}
+
+bool CheckpointFile::load(CheckpointRecord* out) const {
+    bool found = false;
+    for (int i = 0; i < 2; i++) {
+        CheckpointRecord record;
+        memcpy(&record, base + i * CHECKPOINT_PAGE, sizeof(record));
+        if (!record_valid(record)) continue;
+        if (!found || record.seq > out->seq) {
+            *out = record;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void CheckpointFile::store(int64_t value) {
+    // После смены лидера в файл мог писать другой процесс.
+    CheckpointRecord record;
+    if (load(&record) && record.seq > last_seq) last_seq = record.seq;
+    
+    record.magic = CHECKPOINT_MAGIC;
+    record.seq = last_seq + 1;
+    record.value = value;
+    record.written_at = unix_time_ms();
+    record.checksum = record_checksum(record);
+    
+    size_t offset = (record.seq & 1) * CHECKPOINT_PAGE;
+    char* page = base + offset;
+    
+#ifdef _WIN32
+    memcpy(page, &record, sizeof(record));
+    FlushViewOfFile(page, CHECKPOINT_PAGE);
+    FlushFileBuffers(file);
+#else
+    if (ring.available()) {
+        memcpy(ring.buffer(0), &record, sizeof(record));
+        ring.queue_write(0, 0, sizeof(record), offset, true, 0);
+        ring.submit(true);
+        if (ring.result(0) != (int)sizeof(record)) {
+            fprintf(stderr, "Ошибка записи контрольной точки: %s\n",
+                    ring.result(0) < 0 ? strerror(-ring.result(0)) : "записано не полностью");
+            return;
+        }
+    } else {
+        memcpy(page, &record, sizeof(record));
+        sync_syscalls++;
+        if (msync(page, CHECKPOINT_PAGE, MS_SYNC) == -1) {
+            perror("msync");
+            return;
+        }
+    }
+#endif
+    last_seq = record.seq;
+}
+
+Checkpointer::Checkpointer(SharedSegment* seg, const char* path, int interval_ms)
+    : skipped(0), seg(seg), file(path), interval_ms(interval_ms),
+      last_value(0), has_value(false), stopping(false) {
+    cost.reset();
+    CheckpointRecord record;
+    if (file.load(&record)) {
+        last_value = record.value;
+        has_value = true;
+    }
+    thread = std::thread(&Checkpointer::run, this);
+}
+
+Checkpointer::~Checkpointer() {
+    stop_thread();
+}
+
+void Checkpointer::finish() {
+    stop_thread();
+    checkpoint();
+}
+
+void Checkpointer::stop_thread() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+    if (thread.joinable()) thread.join();
+}
+
+void Checkpointer::checkpoint() {
+    int64_t value = counter_read(seg);
+    if (has_value && value == last_value) {
+        skipped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    
+    uint64_t start = monotonic_ns();
+    file.store(value);
+    cost.record(monotonic_ns() - start);
+    metric_add(seg->metrics.checkpoints);
+    
+    last_value = value;
+    has_value = true;
+}
+
+void Checkpointer::run() {
+    std::unique_lock<std::mutex> guard(mutex);
+    while (!stopping) {
+        cv.wait_for(guard, std::chrono::milliseconds(interval_ms));
+        if (stopping) break;
+        
+        guard.unlock();
+        checkpoint();
+        guard.lock();
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include "platform.h"
+#include "io_ring.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// Контрольные точки значения счетчика на диске (COUNTER_PERSIST=ФАЙЛ).
+// Файл отображается в память и состоит из двух страниц с записью
+// CheckpointRecord в каждой. Новая запись пишется в страницу, где нет
+// последней удачной, и сбрасывается на диск msync(MS_SYNC) только этой
+// страницы. Оборванная запись не сходится по контрольной сумме, и при
+// восстановлении берется запись из другой страницы.
+//
+// В Linux с io_uring (COUNTER_IO_URING, см. io_ring.h) запись уходит не
+// через отображение, а из зарегистрированного буфера: pwrite записи и
+// связанный с ним fdatasync отправляются и дожидаются одним io_uring_enter.
+// Отображение по-прежнему служит для чтения.
+//
+// Процесс counter, создающий сегмент разделяемой памяти, начинает со
+// значения из последней удачной контрольной точки вместо 1: main передает
+// checkpoint_recover в SharedMemory как действие при создании, а бенчмарк и
+// утилиты файл не читают. Контрольные точки пишет фоновый поток лидера раз
+// в COUNTER_PERSIST_MS (1000) мс, если значение изменилось, и еще раз при
+// выходе лидера.
+
+#define CHECKPOINT_MAGIC 0x31544e4354505843ull
+#define CHECKPOINT_PAGE 4096
+
+struct CheckpointRecord {
+    uint64_t magic;
+    uint64_t seq;
+    int64_t value;
+    int64_t written_at;
+    uint64_t checksum;
+};
+
+const char* checkpoint_path();
+bool checkpoint_recover(CheckpointRecord* out);
+void checkpoint_log_restored(const CheckpointRecord& record);
+
+class CheckpointFile {
+public:
+    explicit CheckpointFile(const char* path);
+    ~CheckpointFile();
+    
+    bool load(CheckpointRecord* out) const;
+    void store(int64_t value);
+    uint64_t syscalls() const { return ring.syscalls() + sync_syscalls; }
+    bool uses_io_uring() const { return ring.available(); }
+    
+private:
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+    char* base;
+    uint64_t last_seq;
+    IoRing ring;
+    uint64_t sync_syscalls;
+};
+
+class Checkpointer {
+public:
+    Checkpointer(SharedSegment* seg, const char* path, int interval_ms);
+    ~Checkpointer();
+    
+    // Останавливает поток и записывает последнюю контрольную точку;
+    // вызывается лидером при выходе.
+    void finish();
+    
+    LatencyHistogram cost;
+    std::atomic<uint64_t> skipped;
+    
+private:
+    SharedSegment* seg;
+    CheckpointFile file;
+    int interval_ms;
+    int64_t last_value;
+    bool has_value;
+    bool stopping;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+    
+    void checkpoint();
+    void stop_thread();
+    void run();
+};
+
+#endif
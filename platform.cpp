@@ -1,97 +1,62 @@
 #include "platform.h"
+#include "trace.h"
 #include <sstream>
 #include <iomanip>
+#include <thread>
 
-Timestamp get_current_timestamp() {
-    Timestamp ts = {0};
-    
-#ifdef _WIN32
-    struct _timeb timebuffer;
-    _ftime64(&timebuffer);
-    struct tm tm_struct;
-    localtime_s(&tm_struct, &timebuffer.time);
-    
-    ts.year = tm_struct.tm_year + 1900;
-    ts.month = tm_struct.tm_mon + 1;
-    ts.day = tm_struct.tm_mday;
-    ts.hour = tm_struct.tm_hour;
-    ts.minute = tm_struct.tm_min;
-    ts.second = tm_struct.tm_sec;
-    ts.millisecond = timebuffer.millitm;
-#else
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    struct tm tm_struct;
-    localtime_r(&tv.tv_sec, &tm_struct);
-    
-    ts.year = tm_struct.tm_year + 1900;
-    ts.month = tm_struct.tm_mon + 1;
-    ts.day = tm_struct.tm_mday;
-    ts.hour = tm_struct.tm_hour;
-    ts.minute = tm_struct.tm_min;
-    ts.second = tm_struct.tm_sec;
-    ts.millisecond = tv.tv_usec / 1000;
+#ifndef _WIN32
+extern char** environ;
 #endif
-    
-    return ts;
+
+#ifndef _WIN32
+static const int MUTEX_MAX_SPIN = 100;
+
+static void init_shared_mutex(pthread_mutex_t* m) {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(m, &attr);
+    pthread_mutexattr_destroy(&attr);
 }
 
-std::string format_timestamp(const Timestamp& ts) {
-    char buffer[64];
-    snprintf(buffer, sizeof(buffer), 
-            "%04d-%02d-%02d %02d:%02d:%02d.%03d",
-            ts.year, ts.month, ts.day,
-            ts.hour, ts.minute, ts.second,
-            ts.millisecond);
-    return std::string(buffer);
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
 }
+#endif
 
-void log_message(const char* message) {
-    const char* log_filename = "counter_log.txt";
-    
-#ifdef _WIN32
-    HANDLE hFile = CreateFileA(log_filename, 
-                              GENERIC_WRITE, 
-                              FILE_SHARE_READ | FILE_SHARE_WRITE,
-                              NULL,
-                              OPEN_ALWAYS,
-                              FILE_ATTRIBUTE_NORMAL,
-                              NULL);
-    
-    if (hFile == INVALID_HANDLE_VALUE) return;
-    
-    SetFilePointer(hFile, 0, NULL, FILE_END);
-    
-    OVERLAPPED overlapped = {0};
-    LockFileEx(hFile, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
-    
-    DWORD bytes_written;
-    std::string msg_str = std::string(message) + "\n";
-    WriteFile(hFile, msg_str.c_str(), (DWORD)msg_str.length(), &bytes_written, NULL);
-    
-    UnlockFileEx(hFile, 0, MAXDWORD, MAXDWORD, &overlapped);
-    CloseHandle(hFile);
-#else
-    FILE* f = fopen(log_filename, FOPEN_APPEND);
-    if (!f) return;
-    
-    flock(fileno(f), LOCK_EX);
-    fprintf(f, "%s\n", message);
-    fflush(f);
-    flock(fileno(f), LOCK_UN);
-    fclose(f);
+static void init_segment(SharedSegment* seg) {
+    memset((void*)seg, 0, sizeof(SharedSegment));
+    seg->counter.value.store(1);
+    seg->counter.sharded = env_int("COUNTER_SHARDED", 0) != 0;
+    for (int i = 0; i < ROLE_COUNT; i++) {
+        seg->participants.roles[i].last_exit_status.store(-1);
+    }
+#ifndef _WIN32
+    init_shared_mutex(&seg->counter.mutex);
 #endif
+    for (uint64_t i = 0; i < LOG_RING_SLOTS; i++) {
+        seg->log_ring.slots[i].seq.store(i);
+    }
+    for (uint64_t i = 0; i < JOB_QUEUE_SLOTS; i++) {
+        seg->pool.slots[i].seq.store(i);
+    }
 }
 
-SharedMemory::SharedMemory() : handle(0), ptr(nullptr), is_owner(false) {
+SharedMemory::SharedMemory(const char* name, void (*on_create)(SharedSegment* seg))
+    : handle(0), ptr(nullptr), is_owner(false) {
 #ifdef _WIN32
     handle = CreateFileMappingA(
         INVALID_HANDLE_VALUE,
         NULL,
         PAGE_READWRITE,
         0,
-        sizeof(SharedCounter),
-        SHM_NAME  
+        sizeof(SharedSegment),
+        name
     );
     
     if (handle == NULL) {
@@ -105,7 +70,7 @@ SharedMemory::SharedMemory() : handle(0), ptr(nullptr), is_owner(false) {
         is_owner = true;
     }
     
-    ptr = (SharedCounter*)MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedCounter));
+    ptr = (SharedSegment*)MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SharedSegment));
     if (!ptr) {
         CloseHandle(handle);
         fprintf(stderr, "Ошибка отображения памяти: %lu\n", GetLastError());
@@ -113,46 +78,46 @@ SharedMemory::SharedMemory() : handle(0), ptr(nullptr), is_owner(false) {
     }
     
     if (is_owner) {
-        memset(ptr, 0, sizeof(SharedCounter));
-        ptr->value = 1;
-        ptr->initialized = true;
+        init_segment(ptr);
+        if (on_create) on_create(ptr);
+        ptr->counter.initialized.store(1, std::memory_order_release);
+    }
+    for (int i = 0; i < 1000 && !ptr->counter.initialized.load(std::memory_order_acquire); i++) {
+        sleep_ms(1);
     }
 #else
-    handle = shm_open(SHM_NAME, O_RDWR, 0666);
-    
+    handle = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (handle == -1 && errno == EEXIST) handle = shm_open(name, O_RDWR, 0666);
     if (handle == -1) {
-        handle = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
-        if (handle == -1) {
-            perror("shm_open");
-            exit(1);
-        }
-        is_owner = true;
-        if (ftruncate(handle, sizeof(SharedCounter)) == -1) {
-            perror("ftruncate");
-            exit(1);
-        }
-    } else {
-        is_owner = false;
+        perror("shm_open");
+        exit(1);
+    }
+    
+    // Инициализация - под flock сегмента: создатель держит его, пока не
+    // опубликует initialized, остальные ждут на нем. Если создатель умер
+    // раньше, сегмент инициализирует первый, кто получит блокировку.
+    while (flock(handle, LOCK_EX) == -1 && errno == EINTR) {}
+    struct stat st;
+    if (fstat(handle, &st) == -1 ||
+        ((size_t)st.st_size < sizeof(SharedSegment) && ftruncate(handle, sizeof(SharedSegment)) == -1)) {
+        perror("ftruncate");
+        exit(1);
     }
     
-    ptr = (SharedCounter*)mmap(NULL, sizeof(SharedCounter), 
+    ptr = (SharedSegment*)mmap(NULL, sizeof(SharedSegment), 
                                PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
     if (ptr == MAP_FAILED) {
         perror("mmap");
         exit(1);
     }
     
-    if (is_owner) {
-        memset(ptr, 0, sizeof(SharedCounter));
-        ptr->value = 1;
-        ptr->initialized = true;
-    }
-    
-    int wait_count = 0;
-    while (!ptr->initialized && wait_count < 100) {
-        usleep(10000);
-        wait_count++;
+    if (!ptr->counter.initialized.load(std::memory_order_acquire)) {
+        init_segment(ptr);
+        if (on_create) on_create(ptr);
+        ptr->counter.initialized.store(1, std::memory_order_release);
+        is_owner = true;
     }
+    flock(handle, LOCK_UN);
 #endif
 }
 
@@ -162,7 +127,7 @@ SharedMemory::~SharedMemory() {
         UnmapViewOfFile(ptr);
         if (handle) CloseHandle(handle);
 #else
-        munmap(ptr, sizeof(SharedCounter));
+        munmap(ptr, sizeof(SharedSegment));
         if (handle != -1) {
             close(handle);
         }
@@ -171,10 +136,15 @@ SharedMemory::~SharedMemory() {
 }
 
 SharedCounter* SharedMemory::get() {
+    return &ptr->counter;
+}
+
+SharedSegment* SharedMemory::segment() {
     return ptr;
 }
 
-Mutex::Mutex() : handle(0), is_owner(false) {
+Mutex::Mutex(SharedMemory* shm) : handle(0), is_owner(false), spin_estimate(0), counter(shm->get()),
+                                   metrics(&shm->segment()->metrics) {
 #ifdef _WIN32
     handle = CreateSemaphoreA(NULL, 1, 1, SEM_NAME); 
     if (handle == NULL) {
@@ -186,164 +156,246 @@ Mutex::Mutex() : handle(0), is_owner(false) {
         is_owner = true;
     }
 #else
-    handle = sem_open(SEM_NAME, O_CREAT, 0666, 1);
-    if (handle == SEM_FAILED) {
-        perror("sem_open");
-        exit(1);
-    }
+    handle = &shm->get()->mutex;
+#endif
+
+#ifdef COUNTER_LOCK_STATS
+    stats = lock_stats_claim(&shm->segment()->lock_stats, (int64_t)get_current_pid());
+    held_site = -1;
+    acquired_at = 0;
 #endif
 }
 
 Mutex::~Mutex() {
 #ifdef _WIN32
     if (handle) CloseHandle(handle);
-#else
-    if (handle != SEM_FAILED) {
-        sem_close(handle);
-    }
 #endif
 }
 
-void Mutex::lock() {
-#ifdef _WIN32
-    WaitForSingleObject(handle, INFINITE);
-#else
-    sem_wait(handle);
-#endif
+#ifdef COUNTER_LOCK_STATS
+static const char* lock_site_ptrs[LOCK_STATS_SITES];
+
+void Mutex::record_acquire(const char* site, bool contended, uint64_t wait_ns) {
+    acquired_at = monotonic_ns();
+    held_site = -1;
+    if (!stats) return;
+    
+    stats->acquires.fetch_add(1, std::memory_order_relaxed);
+    if (contended) stats->contended.fetch_add(1, std::memory_order_relaxed);
+    stats->wait.record(wait_ns);
+    
+    for (int i = 0; i < LOCK_STATS_SITES && held_site < 0; i++) {
+        if (lock_site_ptrs[i] == site) held_site = i;
+    }
+    for (int i = 0; i < LOCK_STATS_SITES && held_site < 0; i++) {
+        if (lock_site_ptrs[i]) continue;
+        lock_site_ptrs[i] = site;
+        snprintf(stats->sites[i].name, LOCK_SITE_NAME, "%s", site);
+        held_site = i;
+    }
+    if (held_site < 0) return;
+    
+    LockSiteStats& s = stats->sites[held_site];
+    s.acquires.fetch_add(1, std::memory_order_relaxed);
+    if (contended) s.contended.fetch_add(1, std::memory_order_relaxed);
+    s.wait_ns.fetch_add(wait_ns, std::memory_order_relaxed);
 }
 
-void Mutex::unlock() {
-#ifdef _WIN32
-    ReleaseSemaphore(handle, 1, NULL);
-#else
-    sem_post(handle);
-#endif
+void Mutex::record_release() {
+    if (!stats) return;
+    
+    uint64_t hold_ns = monotonic_ns() - acquired_at;
+    stats->hold.record(hold_ns);
+    if (held_site >= 0) stats->sites[held_site].hold_ns.fetch_add(hold_ns, std::memory_order_relaxed);
 }
 
-LeaderElection::LeaderElection() : lock_file(0), is_leader(false), my_pid(get_current_pid()) {
-    const char* lock_filename = "counter_leader.lock";
+void Mutex::lock(const char* site) {
+    uint64_t start = monotonic_ns();
+#else
+void Mutex::lock() {
+#endif
+    bool contended = false;
+    uint64_t wait_start = 0;
     
 #ifdef _WIN32
-    lock_file = CreateFileA(lock_filename,
-                           GENERIC_READ | GENERIC_WRITE,
-                           0,
-                           NULL,
-                           CREATE_NEW,
-                           FILE_ATTRIBUTE_NORMAL,
-                           NULL);
-    
-    if (lock_file != INVALID_HANDLE_VALUE) {
-        is_leader = true;
-        char pid_str[32];
-        snprintf(pid_str, sizeof(pid_str), "%lu", (unsigned long)my_pid);
-        DWORD bytes_written;
-        WriteFile(lock_file, pid_str, (DWORD)strlen(pid_str), &bytes_written, NULL);
-    } else {
-        HANDLE h = CreateFileA(lock_filename,
-                              GENERIC_READ,
-                              FILE_SHARE_READ,
-                              NULL,
-                              OPEN_EXISTING,
-                              FILE_ATTRIBUTE_NORMAL,
-                              NULL);
-        
-        if (h != INVALID_HANDLE_VALUE) {
-            char pid_str[32] = {0};
-            DWORD bytes_read;
-            ReadFile(h, pid_str, sizeof(pid_str) - 1, &bytes_read, NULL);
-            CloseHandle(h);
-            
-            unsigned long leader_pid = strtoul(pid_str, NULL, 10);
-            if (leader_pid == 0 || !is_process_alive((platform_pid_t)leader_pid)) {
-                CloseHandle(lock_file);
-                DeleteFileA(lock_filename);
-                
-                lock_file = CreateFileA(lock_filename,
-                                       GENERIC_READ | GENERIC_WRITE,
-                                       0,
-                                       NULL,
-                                       CREATE_NEW,
-                                       FILE_ATTRIBUTE_NORMAL,
-                                       NULL);
-                
-                if (lock_file != INVALID_HANDLE_VALUE) {
-                    is_leader = true;
-                    char pid_str[32];
-                    snprintf(pid_str, sizeof(pid_str), "%lu", (unsigned long)my_pid);
-                    DWORD bytes_written;
-                    WriteFile(lock_file, pid_str, (DWORD)strlen(pid_str), &bytes_written, NULL);
-                }
-            }
-        }
+    if (WaitForSingleObject(handle, 0) == WAIT_TIMEOUT) {
+        contended = true;
+        wait_start = monotonic_ns();
+        WaitForSingleObject(handle, INFINITE);
     }
 #else
-    int fd = open(lock_filename, O_CREAT | O_EXCL | O_RDWR, 0644);
+    int estimate = spin_estimate.load(std::memory_order_relaxed);
+    int max_spin = estimate * 2 + 10;
+    if (max_spin > MUTEX_MAX_SPIN) max_spin = MUTEX_MAX_SPIN;
+    
+    int spins = 0;
+    int rc = pthread_mutex_trylock(handle);
+    contended = (rc == EBUSY);
+    if (contended) wait_start = monotonic_ns();
+    while (rc == EBUSY && spins < max_spin) {
+        cpu_relax();
+        spins++;
+        rc = pthread_mutex_trylock(handle);
+    }
     
-    if (fd != -1) {
-        is_leader = true;
-        lock_file = fdopen(fd, "w");
-        fprintf(lock_file, "%ld", (long)my_pid);
-        fflush(lock_file);
+    if (rc == EBUSY) {
+        rc = pthread_mutex_lock(handle);
     } else {
-        FILE* f = fopen(lock_filename, "r");
-        if (f) {
-            long leader_pid = 0;
-            fscanf(f, "%ld", &leader_pid);
-            fclose(f);
-            
-            if (leader_pid == 0 || !is_process_alive((platform_pid_t)leader_pid)) {
-                unlink(lock_filename);
-                
-                fd = open(lock_filename, O_CREAT | O_EXCL | O_RDWR, 0644);
-                if (fd != -1) {
-                    is_leader = true;
-                    lock_file = fdopen(fd, "w");
-                    fprintf(lock_file, "%ld", (long)my_pid);
-                    fflush(lock_file);
-                }
-            }
+        spin_estimate.store(estimate + (spins - estimate) / 8, std::memory_order_relaxed);
+    }
+    
+    if (rc == EOWNERDEAD) {
+        pthread_mutex_consistent(handle);
+        // Владелец умер посреди свертки шардов: база уже старая или уже
+        // новая (см. apply_batch), остается закрыть эпоху.
+        uint64_t epoch = counter->shard_epoch.load();
+        if (epoch & 1) counter->shard_epoch.store(epoch + 1);
+        
+        char ts[TIMESTAMP_SIZE];
+        format_current_timestamp(ts, sizeof(ts));
+        char buffer[256];
+        snprintf(buffer, sizeof(buffer),
+                "[%s] PID=%lld WARNING: mutex owner died, lock recovered",
+                ts,
+                (long long)get_current_pid());
+        log_message(buffer);
+    } else if (rc != 0) {
+        errno = rc;
+        perror("pthread_mutex_lock");
+        exit(1);
+    }
+#endif
+    
+    if (contended) {
+        uint64_t waited = monotonic_ns() - wait_start;
+        metric_add(metrics->lock_waits);
+        metric_add(metrics->lock_wait_ns, waited);
+        if (trace_ring) {
+            trace_record_at(TRACE_LOCK_WAIT, 'B', wait_start, 0);
+            trace_record_at(TRACE_LOCK_WAIT, 'E', wait_start + waited, 0);
         }
     }
+    trace_begin(TRACE_LOCK_HOLD);
+
+#ifdef COUNTER_LOCK_STATS
+    record_acquire(site, contended, monotonic_ns() - start);
 #endif
 }
 
-LeaderElection::~LeaderElection() {
-    if (is_leader) {
+void Mutex::unlock() {
+    trace_end(TRACE_LOCK_HOLD);
+#ifdef COUNTER_LOCK_STATS
+    record_release();
+#endif
 #ifdef _WIN32
-        if (lock_file && lock_file != INVALID_HANDLE_VALUE) {
-            CloseHandle(lock_file);
-            DeleteFileA("counter_leader.lock");
-        }
+    ReleaseSemaphore(handle, 1, NULL);
 #else
-        if (lock_file) {
-            fclose(lock_file);
-            unlink("counter_leader.lock");
-        }
+    pthread_mutex_unlock(handle);
 #endif
+}
+
+void counter_write_begin(SharedCounter* sc) {
+    int64_t me = (int64_t)get_current_pid();
+    int64_t writer = 0;
+    for (int spins = 1; !sc->state_writer.compare_exchange_weak(writer, me, std::memory_order_acquire); spins++) {
+        if (writer != 0 && spins % 64 == 0 && !is_process_alive((platform_pid_t)writer) &&
+            sc->state_writer.compare_exchange_strong(writer, me, std::memory_order_acquire)) {
+            uint64_t seq = sc->state_seq.load(std::memory_order_relaxed);
+            if (seq & 1) sc->state_seq.store(seq + 1, std::memory_order_relaxed);
+            break;
+        }
+        if (writer != 0) std::this_thread::yield();
+        writer = 0;
+    }
+    sc->state_seq.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+void counter_write_end(SharedCounter* sc) {
+    sc->state_seq.fetch_add(1, std::memory_order_release);
+    sc->state_writer.store(0, std::memory_order_release);
+}
+
+static inline uint32_t lease_now_ms() {
+    return (uint32_t)(monotonic_ns() / 1000000);
+}
+
+static inline uint64_t lease_word(platform_pid_t pid, uint32_t deadline) {
+    return ((uint64_t)(uint32_t)pid << 32) | deadline;
+}
+
+LeaderElection::LeaderElection(SharedMemory* shm)
+    : lease(&shm->segment()->lease), counter(shm->get()), is_leader(false), my_pid(get_current_pid()) {
+    int ms = env_int("COUNTER_LEASE_MS", 1000);
+    lease_ms = (uint32_t)(ms < 30 ? 30 : ms);
+    try_acquire();
+}
+
+LeaderElection::~LeaderElection() {
+    if (!is_leader) return;
+    
+    uint64_t current = lease->holder.load();
+    if ((platform_pid_t)(current >> 32) == my_pid) {
+        lease->holder.compare_exchange_strong(current, 0);
     }
+    is_leader = false;
 }
 
 bool LeaderElection::is_current_leader() {
-    if (is_leader) {
-        update_activity();
-        return true;
+    return is_leader.load(std::memory_order_relaxed);
+}
+
+bool LeaderElection::try_acquire() {
+    if (is_leader) return renew();
+    
+    uint64_t current = lease->holder.load();
+    platform_pid_t holder = (platform_pid_t)(current >> 32);
+    uint32_t deadline = (uint32_t)current;
+    uint32_t now = lease_now_ms();
+    
+    if (holder != 0 && holder != my_pid &&
+        (int32_t)(deadline - now) > 0 && is_process_alive(holder)) {
+        return false;
+    }
+    
+    if (!lease->holder.compare_exchange_strong(current, lease_word(my_pid, now + lease_ms))) {
+        return false;
+    }
+    
+    lease->epoch.fetch_add(1);
+    is_leader = true;
+    update_activity();
+    return true;
+}
+
+bool LeaderElection::renew() {
+    uint64_t current = lease->holder.load();
+    
+    if ((platform_pid_t)(current >> 32) != my_pid ||
+        !lease->holder.compare_exchange_strong(current, lease_word(my_pid, lease_now_ms() + lease_ms))) {
+        is_leader = false;
+        return false;
     }
-    return false;
+    
+    update_activity();
+    return true;
+}
+
+uint64_t LeaderElection::epoch() {
+    return lease->epoch.load();
+}
+
+int LeaderElection::renew_interval_ms() {
+    return (int)(lease_ms / 3);
 }
 
 void LeaderElection::update_activity() {
     if (!is_leader) return;
     
-    extern SharedMemory* shared_mem;
-    extern Mutex* global_mutex;
-    
-    if (shared_mem && global_mutex) {
-        global_mutex->lock();
-        SharedCounter* sc = shared_mem->get();
-        sc->leader_pid = my_pid;
-        sc->last_leader_activity = time(nullptr);
-        global_mutex->unlock();
-    }
+    counter_write_begin(counter);
+    counter->leader_pid.store(my_pid, std::memory_order_relaxed);
+    counter->last_leader_activity.store(time(nullptr), std::memory_order_relaxed);
+    counter_write_end(counter);
 }
 
 platform_pid_t start_child_process(const char* mode) {
@@ -369,13 +421,20 @@ platform_pid_t start_child_process(const char* mode) {
     
     return pid;
 #else
-    pid_t pid = fork();
-    if (pid == -1) return 0;
-    
-    if (pid == 0) {
-        execl("/proc/self/exe", "/proc/self/exe", mode, (char*)nullptr);
-        exit(1);
-    }
+    char* argv[] = { (char*)"/proc/self/exe", (char*)mode, nullptr };
+    pid_t pid;
+    
+    // Лидер блокирует сигналы завершения ради signalfd, дочерний процесс
+    // должен получать их как обычно.
+    posix_spawnattr_t attr;
+    sigset_t empty;
+    sigemptyset(&empty);
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    int rc = posix_spawn(&pid, "/proc/self/exe", nullptr, &attr, argv, environ);
+    posix_spawnattr_destroy(&attr);
+    if (rc != 0) return 0;
     
     return pid;
 #endif
@@ -7,6 +7,9 @@
 #include <ctime>
 #include <cstdint>
 #include <string>
+#include <atomic>
+#include "segment.h"
+#include "timestamp.h"
 
 #ifdef _WIN32
     #define WIN32_LEAN_AND_MEAN
@@ -16,7 +19,6 @@
     #include <fcntl.h>
     #include <sys/timeb.h>
     
-    typedef DWORD platform_pid_t;
     typedef HANDLE platform_shm_t;
     typedef HANDLE platform_sem_t;
     typedef HANDLE platform_file_t;
@@ -32,7 +34,6 @@
         return std::string(path);
     }
     
-    #define SHM_NAME "CounterSharedMemory"
     #define SEM_NAME "CounterMutex"
 #else
     #include <unistd.h>
@@ -40,16 +41,16 @@
     #include <sys/wait.h>
     #include <sys/mman.h>
     #include <fcntl.h>
-    #include <semaphore.h>
+    #include <pthread.h>
     #include <sys/stat.h>
     #include <sys/file.h>
     #include <signal.h>
     #include <sys/time.h>
     #include <errno.h>
+    #include <spawn.h>
     
-    typedef pid_t platform_pid_t;
     typedef int platform_shm_t;
-    typedef sem_t* platform_sem_t;
+    typedef pthread_mutex_t* platform_sem_t;
     typedef FILE* platform_file_t;
     
     #define FOPEN_APPEND "a"
@@ -57,65 +58,92 @@
     inline platform_pid_t get_current_pid() { return getpid(); }
     inline void sleep_ms(int ms) { usleep(ms * 1000); }
     inline const char* get_executable_path() { return "/proc/self/exe"; }
-    
-    #define SHM_NAME "/counter_shared_mem"
-    #define SEM_NAME "/counter_mutex"
 #endif
 
-struct Timestamp {
-    int year, month, day;
-    int hour, minute, second, millisecond;
-};
-
-Timestamp get_current_timestamp();
-std::string format_timestamp(const Timestamp& ts);
 void log_message(const char* message);
+void log_flush();
+void log_shutdown();
+inline int env_int(const char* name, int default_value) {
+    const char* value = getenv(name);
+    if (!value || !*value) return default_value;
+    return atoi(value);
+}
 
-struct SharedCounter {
-    int64_t value;
-    platform_pid_t child1_pid;
-    platform_pid_t child2_pid;
-    time_t child1_start_time;
-    time_t child2_start_time;
-    platform_pid_t leader_pid;
-    time_t last_leader_activity;
-    bool initialized;
-};
+// Писатели исключают друг друга через state_writer (PID писателя), затем
+// делают state_seq нечетным; global_mutex для этого не нужен. Если писатель
+// умер внутри секции, ждущий писатель забирает state_writer себе и
+// возвращает state_seq к четному. Секция должна быть короткой: только
+// присваивания полей.
+void counter_write_begin(SharedCounter* sc);
+void counter_write_end(SharedCounter* sc);
+
+void log_attach_ring(LogRing* ring);
+void log_set_drainer(bool enabled);
 
 class SharedMemory {
 private:
     platform_shm_t handle;
-    SharedCounter* ptr;
+    SharedSegment* ptr;
     bool is_owner;
     
 public:
-    SharedMemory();
+    // on_create вызывается процессом, инициализирующим сегмент, до того как
+    // сегмент станет доступен остальным.
+    explicit SharedMemory(const char* name = SHM_NAME, void (*on_create)(SharedSegment* seg) = nullptr);
     ~SharedMemory();
     SharedCounter* get();
+    SharedSegment* segment();
 };
 
+// POSIX: robust pthread_mutex_t в разделяемой памяти, спин перед сном в ядре,
+// восстановление после смерти владельца (EOWNERDEAD).
 class Mutex {
 private:
     platform_sem_t handle;
     bool is_owner;
+    std::atomic<int> spin_estimate;   // общий для потоков процесса; приблизительный
+    SharedCounter* counter;
+    MetricsPage* metrics;
+#ifdef COUNTER_LOCK_STATS
+    LockStatsSlot* stats;
+    int held_site;
+    uint64_t acquired_at;
+    
+    void record_acquire(const char* site, bool contended, uint64_t wait_ns);
+    void record_release();
+#endif
     
 public:
-    Mutex();
+    explicit Mutex(SharedMemory* shm);
     ~Mutex();
+#ifdef COUNTER_LOCK_STATS
+    void lock(const char* site = __builtin_FUNCTION());
+#else
     void lock();
+#endif
     void unlock();
 };
 
+// Лидер - владелец непросроченной аренды в разделяемой памяти
+// (COUNTER_LEASE_MS, по умолчанию 1000 мс). Лидер продлевает аренду каждые
+// треть срока, участники в это же время проверяют ее и забирают
+// просроченную или оставшуюся от умершего процесса.
 class LeaderElection {
 private:
-    platform_file_t lock_file;
-    bool is_leader;
+    LeaderLease* lease;
+    SharedCounter* counter;
+    std::atomic<bool> is_leader;
     platform_pid_t my_pid;
+    uint32_t lease_ms;
     
 public:
-    LeaderElection();
+    explicit LeaderElection(SharedMemory* shm);
     ~LeaderElection();
     bool is_current_leader();
+    bool try_acquire();
+    bool renew();
+    uint64_t epoch();
+    int renew_interval_ms();
     void update_activity();
 };
 
@@ -0,0 +1,160 @@
+#include "pool.h"
+
+#ifdef __linux__
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+#endif
+
+static const int WORKER_IDLE_CHECK_MS = 1000;
+// Рабочий записывает свой PID в job_pid сразу после извлечения задания.
+// Если очередь пуста, а задание так и числится ожидающим (-1) дольше
+// этого срока, рабочий умер между извлечением и записью PID.
+static const int JOB_CLAIM_TIMEOUT_MS = 1000;
+
+static void wait_for_jobs(std::atomic<uint32_t>* word, uint32_t seen) {
+#ifdef __linux__
+    struct timespec timeout = { WORKER_IDLE_CHECK_MS / 1000, (WORKER_IDLE_CHECK_MS % 1000) * 1000000L };
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAIT, seen, &timeout, nullptr, 0);
+#else
+    if (word->load() == seen) sleep_ms(1);
+#endif
+}
+
+static void wake_workers(std::atomic<uint32_t>* word, int count) {
+    word->fetch_add(1);
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)word, FUTEX_WAKE, count, nullptr, nullptr, 0);
+#else
+    (void)count;
+#endif
+}
+
+static bool pool_push(JobPool* pool, JobKind kind) {
+    uint64_t pos = pool->head.load(std::memory_order_relaxed);
+    
+    while (true) {
+        JobSlot& slot = pool->slots[pos % JOB_QUEUE_SLOTS];
+        int64_t diff = (int64_t)(slot.seq.load(std::memory_order_acquire) - pos);
+        
+        if (diff == 0) {
+            if (pool->head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.kind = kind;
+                slot.seq.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = pool->head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+static JobKind pool_pop(JobPool* pool) {
+    uint64_t pos = pool->tail.load(std::memory_order_relaxed);
+    
+    while (true) {
+        JobSlot& slot = pool->slots[pos % JOB_QUEUE_SLOTS];
+        int64_t diff = (int64_t)(slot.seq.load(std::memory_order_acquire) - (pos + 1));
+        
+        if (diff == 0) {
+            if (pool->tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                JobKind kind = (JobKind)slot.kind;
+                slot.seq.store(pos + JOB_QUEUE_SLOTS, std::memory_order_release);
+                return kind;
+            }
+        } else if (diff < 0) {
+            return JOB_NONE;
+        } else {
+            pos = pool->tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+int pool_configured_workers() {
+    int workers = env_int("COUNTER_POOL_WORKERS", 0);
+    return workers < 0 ? 0 : workers;
+}
+
+int pool_start_workers(JobPool* pool, int count, platform_pid_t* pids) {
+    pool->shutdown.store(0);
+    pool->owner_pid.store((int64_t)get_current_pid());
+    
+    int started = 0;
+    for (int i = 0; i < count; i++) {
+        platform_pid_t pid = start_child_process("--worker");
+        if (pid != 0) pids[started++] = pid;
+    }
+    return started;
+}
+
+void pool_shutdown(JobPool* pool) {
+    pool->shutdown.store(1);
+    wake_workers(&pool->wake_seq, INT32_MAX);
+}
+
+bool pool_busy(JobPool* pool, JobKind kind, int64_t* pid) {
+    int64_t owner = pool->job_pid[kind].load();
+    if (owner > 0 && !is_process_alive((platform_pid_t)owner)) {
+        pool->job_pid[kind].compare_exchange_strong(owner, 0);
+        owner = 0;
+    } else if (owner == -1 && pool->tail.load() == pool->head.load()) {
+        uint64_t requested = pool->requested_ns[kind].load();
+        uint64_t now = monotonic_ns();
+        if (requested != 0 && now > requested && now - requested > JOB_CLAIM_TIMEOUT_MS * 1000000ull &&
+            pool->job_pid[kind].compare_exchange_strong(owner, 0)) {
+            pool->requested_ns[kind].store(0);
+            owner = 0;
+        }
+    }
+    *pid = owner;
+    return owner != 0;
+}
+
+bool pool_submit(JobPool* pool, JobKind kind) {
+    int64_t idle = 0;
+    if (!pool->job_pid[kind].compare_exchange_strong(idle, -1)) return false;
+    
+    pool_mark_requested(pool, kind);
+    if (!pool_push(pool, kind)) {
+        pool->job_pid[kind].store(0);
+        return false;
+    }
+    wake_workers(&pool->wake_seq, 1);
+    return true;
+}
+
+void pool_worker_loop(JobPool* pool, void (*run)(JobKind kind), void (*idle)()) {
+    int64_t my_pid = (int64_t)get_current_pid();
+    
+    while (!pool->shutdown.load()) {
+        uint32_t seen = pool->wake_seq.load();
+        JobKind kind = pool_pop(pool);
+        
+        if (kind == JOB_NONE) {
+            wait_for_jobs(&pool->wake_seq, seen);
+            if (idle) idle();
+            
+            int64_t owner = pool->owner_pid.load();
+            if (owner != 0 && !is_process_alive((platform_pid_t)owner)) break;
+            continue;
+        }
+        
+        pool->job_pid[kind].store(my_pid);
+        pool_record_dispatch(pool, kind);
+        run(kind);
+        pool->job_pid[kind].store(0);
+    }
+}
+
+void pool_mark_requested(JobPool* pool, JobKind kind) {
+    pool->requested_ns[kind].store(monotonic_ns());
+}
+
+void pool_record_dispatch(JobPool* pool, JobKind kind) {
+    uint64_t requested = pool->requested_ns[kind].exchange(0);
+    if (requested == 0) return;
+    
+    uint64_t now = monotonic_ns();
+    if (now > requested) pool->dispatch.record(now - requested);
+}
@@ -0,0 +1,31 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include "platform.h"
+
+// Пул рабочих процессов для заданий child1/child2 (COUNTER_POOL_WORKERS=N
+// у лидера). Рабочие ждут на futex-слове wake_seq и выполняют задания из
+// JobPool, поэтому запуск задания не требует fork/exec.
+
+int pool_configured_workers();
+// PID запущенных рабочих записываются в pids (не меньше count элементов),
+// возвращается их число.
+int pool_start_workers(JobPool* pool, int count, platform_pid_t* pids);
+void pool_shutdown(JobPool* pool);
+
+// Возвращает true, если задание kind еще в очереди или выполняется;
+// в *pid - PID рабочего (или -1, если задание ждет в очереди). Задание
+// умершего рабочего считается завершенным.
+bool pool_busy(JobPool* pool, JobKind kind, int64_t* pid);
+bool pool_submit(JobPool* pool, JobKind kind);
+
+// Цикл рабочего процесса: выполняет задания, пока не выставлен shutdown
+// или пока жив процесс, запустивший пул. idle вызывается после каждого
+// пробуждения без задания (не реже раза в секунду).
+void pool_worker_loop(JobPool* pool, void (*run)(JobKind kind), void (*idle)() = nullptr);
+
+// Учет задержки от запроса задания до его начала (для обоих режимов).
+void pool_mark_requested(JobPool* pool, JobKind kind);
+void pool_record_dispatch(JobPool* pool, JobKind kind);
+
+#endif
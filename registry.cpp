@@ -0,0 +1,238 @@
+#include "registry.h"
+
+static const uint32_t BUCKET_EMPTY = 0;
+static const uint32_t BUCKET_READY = 1;
+
+static inline uint32_t extent_buckets(uint32_t index) {
+    return REGISTRY_FIRST_EXTENT << index;
+}
+
+static inline size_t extent_offset(uint32_t index) {
+    return REGISTRY_HEADER_SIZE + (size_t)(extent_buckets(index) - REGISTRY_FIRST_EXTENT) * sizeof(RegistryBucket);
+}
+
+static inline size_t registry_size(uint32_t extent_count) {
+    return extent_offset(extent_count);
+}
+
+static uint32_t hash_key(const char* key) {
+    uint32_t h = 2166136261u;
+    for (; *key; key++) {
+        h ^= (uint8_t)*key;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+CounterRegistry::CounterRegistry(Mutex* m) : handle(0), header(nullptr), mutex(m) {
+    for (int i = 0; i < REGISTRY_MAX_EXTENTS; i++) extents[i].store(nullptr);
+    
+    bool is_owner = false;
+    
+#ifdef _WIN32
+    size_t max_size = registry_size(REGISTRY_MAX_EXTENTS);
+    handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                (DWORD)((uint64_t)max_size >> 32), (DWORD)max_size,
+                                REGISTRY_SHM_NAME);
+    if (handle == NULL) {
+        fprintf(stderr, "Ошибка создания реестра счетчиков: %lu\n", GetLastError());
+        exit(1);
+    }
+    is_owner = (GetLastError() != ERROR_ALREADY_EXISTS);
+    
+    header = (RegistryHeader*)MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, REGISTRY_HEADER_SIZE);
+    if (!header) {
+        fprintf(stderr, "Ошибка отображения реестра счетчиков: %lu\n", GetLastError());
+        exit(1);
+    }
+#else
+    handle = shm_open(REGISTRY_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (handle == -1 && errno == EEXIST) handle = shm_open(REGISTRY_SHM_NAME, O_RDWR, 0666);
+    if (handle == -1) {
+        perror("shm_open");
+        exit(1);
+    }
+    
+    // Как в SharedMemory: размер и заголовок задаются под flock, так что
+    // остальные процессы не отображают пустой объект и не видят заголовок
+    // до инициализации; умершего создателя заменяет следующий.
+    while (flock(handle, LOCK_EX) == -1 && errno == EINTR) {}
+    struct stat st;
+    if (fstat(handle, &st) == -1 ||
+        ((size_t)st.st_size < registry_size(1) && ftruncate(handle, registry_size(1)) == -1)) {
+        perror("ftruncate");
+        exit(1);
+    }
+    
+    header = (RegistryHeader*)mmap(NULL, REGISTRY_HEADER_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, handle, 0);
+    if (header == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    is_owner = !header->initialized.load(std::memory_order_acquire);
+#endif
+    
+    if (is_owner) {
+        header->used.store(0);
+        header->extent_count.store(1);
+        header->initialized.store(1, std::memory_order_release);
+    }
+#ifndef _WIN32
+    flock(handle, LOCK_UN);
+#endif
+    
+    for (int i = 0; i < 100 && !header->initialized.load(std::memory_order_acquire); i++) {
+        sleep_ms(10);
+    }
+    if (!header->initialized.load(std::memory_order_acquire)) {
+        fprintf(stderr, "Ошибка: реестр счетчиков %s не инициализирован создателем\n", REGISTRY_SHM_NAME);
+        exit(1);
+    }
+}
+
+CounterRegistry::~CounterRegistry() {
+    for (uint32_t i = 0; i < REGISTRY_MAX_EXTENTS; i++) {
+        RegistryBucket* buckets = extents[i].load();
+        if (!buckets) continue;
+#ifdef _WIN32
+        UnmapViewOfFile(buckets);
+#else
+        munmap(buckets, extent_buckets(i) * sizeof(RegistryBucket));
+#endif
+    }
+    
+#ifdef _WIN32
+    if (header) UnmapViewOfFile(header);
+    if (handle) CloseHandle(handle);
+#else
+    if (header) munmap(header, REGISTRY_HEADER_SIZE);
+    if (handle != -1) close(handle);
+#endif
+}
+
+RegistryBucket* CounterRegistry::extent(uint32_t index) {
+    RegistryBucket* buckets = extents[index].load(std::memory_order_acquire);
+    if (buckets) return buckets;
+    
+    std::lock_guard<std::mutex> guard(map_mutex);
+    buckets = extents[index].load();
+    if (buckets) return buckets;
+    
+    size_t offset = extent_offset(index);
+    size_t length = extent_buckets(index) * sizeof(RegistryBucket);
+#ifdef _WIN32
+    buckets = (RegistryBucket*)MapViewOfFile(handle, FILE_MAP_ALL_ACCESS,
+                                             (DWORD)((uint64_t)offset >> 32), (DWORD)offset, length);
+    if (!buckets) return nullptr;
+#else
+    void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, handle, offset);
+    if (p == MAP_FAILED) return nullptr;
+    buckets = (RegistryBucket*)p;
+#endif
+    extents[index].store(buckets, std::memory_order_release);
+    return buckets;
+}
+
+RegistryBucket* CounterRegistry::find(const char* key, uint32_t hash) {
+    uint32_t count = header->extent_count.load(std::memory_order_acquire);
+    
+    for (uint32_t e = 0; e < count; e++) {
+        RegistryBucket* buckets = extent(e);
+        if (!buckets) return nullptr;
+        
+        uint32_t mask = extent_buckets(e) - 1;
+        for (uint32_t i = hash & mask, probes = 0; probes <= mask; i = (i + 1) & mask, probes++) {
+            RegistryBucket& b = buckets[i];
+            if (b.state.load(std::memory_order_acquire) == BUCKET_EMPTY) break;
+            if (b.hash == hash && strcmp(b.key, key) == 0) return &b;
+        }
+    }
+    return nullptr;
+}
+
+RegistryBucket* CounterRegistry::find_or_create(const char* key) {
+    uint32_t hash = hash_key(key);
+    RegistryBucket* found = find(key, hash);
+    if (found) return found;
+    
+    mutex->lock();
+    
+    found = find(key, hash);
+    if (found) {
+        mutex->unlock();
+        return found;
+    }
+    
+    uint32_t last = header->extent_count.load() - 1;
+    if (header->used.load() + 1 > extent_buckets(last) / 4 * 3) {
+        if (last + 1 >= REGISTRY_MAX_EXTENTS) {
+            mutex->unlock();
+            return nullptr;
+        }
+#ifndef _WIN32
+        if (ftruncate(handle, registry_size(last + 2)) == -1) {
+            mutex->unlock();
+            return nullptr;
+        }
+#endif
+        last++;
+        header->used.store(0);
+        header->extent_count.store(last + 1, std::memory_order_release);
+    }
+    
+    RegistryBucket* buckets = extent(last);
+    if (!buckets) {
+        mutex->unlock();
+        return nullptr;
+    }
+    
+    uint32_t mask = extent_buckets(last) - 1;
+    uint32_t i = hash & mask;
+    while (buckets[i].state.load() != BUCKET_EMPTY) i = (i + 1) & mask;
+    
+    RegistryBucket& b = buckets[i];
+    snprintf(b.key, sizeof(b.key), "%s", key);
+    b.hash = hash;
+    b.value.store(0);
+    b.state.store(BUCKET_READY, std::memory_order_release);
+    header->used.fetch_add(1);
+    
+    mutex->unlock();
+    return &b;
+}
+
+bool CounterRegistry::valid_name(const char* name) {
+    size_t len = strlen(name);
+    return len > 0 && len < REGISTRY_KEY_SIZE;
+}
+
+bool CounterRegistry::get(const char* name, int64_t* value) {
+    if (!valid_name(name)) return false;
+    RegistryBucket* b = find(name, hash_key(name));
+    if (!b) return false;
+    *value = b->value.load();
+    return true;
+}
+
+bool CounterRegistry::set(const char* name, int64_t value) {
+    if (!valid_name(name)) return false;
+    RegistryBucket* b = find_or_create(name);
+    if (!b) return false;
+    b->value.store(value);
+    return true;
+}
+
+bool CounterRegistry::add(const char* name, int64_t delta, int64_t* result) {
+    if (!valid_name(name)) return false;
+    RegistryBucket* b = find_or_create(name);
+    if (!b) return false;
+    *result = b->value.fetch_add(delta) + delta;
+    return true;
+}
+
+uint32_t CounterRegistry::size() {
+    uint32_t count = header->extent_count.load();
+    uint32_t total = header->used.load();
+    for (uint32_t e = 0; e + 1 < count; e++) total += extent_buckets(e) / 4 * 3;
+    return total;
+}
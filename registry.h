@@ -0,0 +1,59 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include "platform.h"
+#include <mutex>
+
+#ifdef _WIN32
+    #define REGISTRY_SHM_NAME "CounterRegistry"
+#else
+    #define REGISTRY_SHM_NAME "/counter_registry"
+#endif
+
+#define REGISTRY_KEY_SIZE 48
+#define REGISTRY_HEADER_SIZE 65536
+#define REGISTRY_FIRST_EXTENT 1024
+#define REGISTRY_MAX_EXTENTS 8
+
+struct RegistryBucket {
+    std::atomic<uint32_t> state;
+    uint32_t hash;
+    std::atomic<int64_t> value;
+    char key[REGISTRY_KEY_SIZE];
+};
+
+struct RegistryHeader {
+    std::atomic<uint32_t> extent_count;
+    std::atomic<uint32_t> used;
+    std::atomic<uint32_t> initialized;   // публикуется последним (release)
+};
+
+// Именованные счетчики в отдельном сегменте. Таблица с открытой адресацией
+// состоит из экстентов (1024, 2048, ... бакетов), каждый отображается
+// отдельно; при заполнении последнего на 3/4 сегмент увеличивается
+// ftruncate и добавляется следующий экстент, старые записи не переносятся.
+// Поиск и изменение значений - без блокировок, создание ключа - под Mutex.
+class CounterRegistry {
+private:
+    platform_shm_t handle;
+    RegistryHeader* header;
+    std::atomic<RegistryBucket*> extents[REGISTRY_MAX_EXTENTS];
+    std::mutex map_mutex;
+    Mutex* mutex;
+    
+    RegistryBucket* extent(uint32_t index);
+    RegistryBucket* find(const char* key, uint32_t hash);
+    RegistryBucket* find_or_create(const char* key);
+    
+public:
+    explicit CounterRegistry(Mutex* mutex);
+    ~CounterRegistry();
+    
+    static bool valid_name(const char* name);
+    bool get(const char* name, int64_t* value);
+    bool set(const char* name, int64_t value);
+    bool add(const char* name, int64_t delta, int64_t* result);
+    uint32_t size();
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include "stats.h"
+
+// Раскладка общего сегмента памяти группы. Заголовок самодостаточен:
+// внешние наблюдатели (counterstat) отображают сегмент и читают поля, не
+// подключая остальной код счетчика. Операции над полями - в platform.h,
+// counter.h, pool.h, participants.h.
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #include <windows.h>
+    
+    typedef DWORD platform_pid_t;
+    
+    #define SHM_NAME "CounterSharedMemory"
+#else
+    #include <sys/types.h>
+    #include <pthread.h>
+    
+    typedef pid_t platform_pid_t;
+    
+    #define SHM_NAME "/counter_shared_mem"
+#endif
+
+// leader_pid и last_leader_activity меняются только внутри
+// counter_write_begin/end, и читатели получают их согласованный снимок
+// через counter_snapshot() без блокировок (seqlock по state_seq). Сами
+// поля атомарны, чтобы чтение во время записи не было гонкой данных.
+struct SharedCounter {
+    std::atomic<int64_t> value;
+    std::atomic<uint64_t> state_seq;
+    std::atomic<int64_t> state_writer;   // PID писателя state_seq; 0 - записи нет
+    std::atomic<platform_pid_t> leader_pid;
+    std::atomic<time_t> last_leader_activity;
+    int32_t sharded;
+    std::atomic<uint64_t> shard_epoch;
+    std::atomic<uint64_t> set_epoch;
+#ifndef _WIN32
+    pthread_mutex_t mutex;
+#endif
+    std::atomic<uint32_t> initialized;
+};
+
+static_assert(std::atomic<int64_t>::is_always_lock_free,
+              "SharedCounter::value must be lock-free to be shared between processes");
+
+#define COUNTER_SHARDS 64
+
+struct alignas(64) CounterShard {
+    std::atomic<int64_t> delta;
+};
+
+// Дельты counter_increment: слот на поток-производитель. Владелец
+// прибавляет к delta, а перенести дельту в счетчик (exchange и counter_add)
+// может любой процесс, поэтому точное чтение видит дельты всей группы.
+#define DELTA_SLOTS 256
+
+struct alignas(64) DeltaSlot {
+    std::atomic<int64_t> owner;      // PID; 0 - свободен, -1 - переносится после смерти владельца
+    std::atomic<int64_t> delta;
+    std::atomic<uint64_t> first_ns;  // первая прибавка, еще не перенесенная в счетчик
+    std::atomic<uint64_t> calls;     // вызовы counter_increment; пишет только владелец
+};
+
+struct DeltaTable {
+    std::atomic<uint64_t> flushes;
+    std::atomic<uint64_t> max_staleness_ns;
+    LatencyHistogram staleness;
+    DeltaSlot slots[DELTA_SLOTS];
+};
+
+#define LOG_RING_SLOTS 1024
+#define LOG_RECORD_SIZE 256
+
+// Старший бит length - в text лежит двоичная запись LogEvent, а не строка.
+#define LOG_RECORD_BINARY 0x80000000u
+
+struct LogRecord {
+    std::atomic<uint64_t> seq;
+    uint32_t length;
+    char text[LOG_RECORD_SIZE - sizeof(uint64_t) - sizeof(uint32_t)];
+};
+
+// Очередь строк лога для всех процессов группы (MPMC, Vyukov):
+// писатели резервируют слот через CAS по head, на диск её выгружает лидер.
+struct LogRing {
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> overflow;
+    LogRecord slots[LOG_RING_SLOTS];
+};
+
+#define JOB_QUEUE_SLOTS 16
+
+enum JobKind {
+    JOB_NONE = 0,
+    JOB_CHILD1 = 1,
+    JOB_CHILD2 = 2,
+    JOB_KINDS = 3
+};
+
+struct JobSlot {
+    std::atomic<uint64_t> seq;
+    uint32_t kind;
+};
+
+// Очередь заданий для заранее запущенных рабочих процессов (--worker).
+// job_pid[kind]: 0 - задание не выполняется, -1 - в очереди, иначе PID
+// рабочего, который его выполняет.
+struct JobPool {
+    std::atomic<uint64_t> head;
+    std::atomic<uint64_t> tail;
+    std::atomic<uint32_t> wake_seq;
+    std::atomic<uint32_t> shutdown;
+    std::atomic<int64_t> owner_pid;
+    std::atomic<int64_t> job_pid[JOB_KINDS];
+    std::atomic<uint64_t> requested_ns[JOB_KINDS];
+    JobSlot slots[JOB_QUEUE_SLOTS];
+    LatencyHistogram dispatch;
+};
+
+// Аренда лидерства: holder = (PID << 32) | срок аренды в младших 32 битах
+// миллисекунд монотонных часов. Захват и продление - CAS этого слова,
+// epoch увеличивается при каждой смене лидера.
+struct LeaderLease {
+    std::atomic<uint64_t> epoch;
+    std::atomic<uint64_t> holder;
+};
+
+// Таблица участников: главные процессы, рабочие пула и дочерние задания.
+// Слот свободен при pid == 0; занимается CAS 0 -> -PID (слот
+// заполняется), после заполнения полей в pid записывается PID владельца.
+// Поля слота меняет только его владелец (кроме освобождения мертвых
+// слотов лидером, в том числе застрявших в заполнении).
+#define PARTICIPANT_SLOTS 512
+
+enum ParticipantRole {
+    ROLE_NONE,
+    ROLE_MAIN,
+    ROLE_LEADER,
+    ROLE_WORKER,
+    ROLE_CHILD1,
+    ROLE_CHILD2,
+    ROLE_COUNT
+};
+
+inline const char* participant_role_name(uint32_t role) {
+    switch (role) {
+    case ROLE_MAIN:   return "main";
+    case ROLE_LEADER: return "leader";
+    case ROLE_WORKER: return "worker";
+    case ROLE_CHILD1: return "child1";
+    case ROLE_CHILD2: return "child2";
+    }
+    return "?";
+}
+
+struct alignas(64) ParticipantSlot {
+    std::atomic<int64_t> pid;
+    std::atomic<uint32_t> role;
+    std::atomic<time_t> started;
+    std::atomic<uint64_t> heartbeat_ns;
+    std::atomic<uint64_t> ops;
+};
+
+// Итоги последнего завершения по ролям (код выхода, время работы).
+struct RoleStats {
+    std::atomic<uint64_t> exits;
+    std::atomic<int32_t> last_exit_status;
+    std::atomic<int64_t> last_runtime_ms;
+};
+
+struct ParticipantTable {
+    RoleStats roles[ROLE_COUNT];
+    ParticipantSlot slots[PARTICIPANT_SLOTS];
+};
+
+// Монотонные счетчики событий для внешнего наблюдения (counterstat).
+// Обновляются relaxed-атомиками только на редких путях (не в counter_add);
+// число строк лога и потерь берется из LogRing, смены лидера - из эпохи
+// аренды.
+struct alignas(64) MetricsPage {
+    std::atomic<uint64_t> increments;
+    std::atomic<uint64_t> sets;
+    std::atomic<uint64_t> spawns;
+    std::atomic<uint64_t> spawn_skips;
+    std::atomic<uint64_t> child_exits;
+    std::atomic<uint64_t> child_failures;
+    std::atomic<uint64_t> lock_waits;
+    std::atomic<uint64_t> lock_wait_ns;
+    std::atomic<uint64_t> control_requests;
+    std::atomic<uint64_t> checkpoints;
+};
+
+inline void metric_add(std::atomic<uint64_t>& metric, uint64_t n = 1) {
+    metric.fetch_add(n, std::memory_order_relaxed);
+}
+
+struct SharedSegment {
+    SharedCounter counter;
+    LeaderLease lease;
+    CounterShard shards[COUNTER_SHARDS];
+    DeltaTable deltas;
+    LogRing log_ring;
+    LockStatsTable lock_stats;
+    JobPool pool;
+    MetricsPage metrics;
+    ParticipantTable participants;
+};
+
+#endif
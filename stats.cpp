@@ -0,0 +1,160 @@
+#include "platform.h"
+#include <chrono>
+
+#ifdef _MSC_VER
+    #include <intrin.h>
+#endif
+
+static inline int highest_bit(uint64_t v) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(v);
+#endif
+}
+
+static inline int bucket_index(uint64_t ns) {
+    if (ns < 4) return (int)ns;
+    int msb = highest_bit(ns);
+    int index = 4 * (msb - 1) + (int)((ns >> (msb - 2)) & 3);
+    return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+static inline uint64_t bucket_upper_bound(int index) {
+    if (index < 4) return (uint64_t)index;
+    int msb = index / 4 + 1;
+    uint64_t sub = (uint64_t)(index % 4);
+    return ((4 + sub + 1) << (msb - 2)) - 1;
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    counts[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        counts[i].fetch_add(other.counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset() {
+    for (int i = 0; i < LATENCY_BUCKETS; i++) counts[i].store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::total() const {
+    uint64_t sum = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) sum += counts[i].load(std::memory_order_relaxed);
+    return sum;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    uint64_t n = total();
+    if (n == 0) return 0;
+    
+    uint64_t rank = (uint64_t)(p * (double)n);
+    if (rank >= n) rank = n - 1;
+    
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += counts[i].load(std::memory_order_relaxed);
+        if (seen > rank) return bucket_upper_bound(i);
+    }
+    return bucket_upper_bound(LATENCY_BUCKETS - 1);
+}
+
+uint64_t monotonic_ns() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LockStatsSlot* lock_stats_claim(LockStatsTable* table, int64_t pid) {
+    for (int i = 0; i < LOCK_STATS_SLOTS; i++) {
+        if (table->slots[i].pid.load() == pid) return &table->slots[i];
+    }
+    
+    for (int i = 0; i < LOCK_STATS_SLOTS; i++) {
+        LockStatsSlot& slot = table->slots[i];
+        int64_t owner = slot.pid.load();
+        if (owner != 0 && is_process_alive((platform_pid_t)owner)) continue;
+        if (!slot.pid.compare_exchange_strong(owner, pid)) continue;
+        
+        slot.acquires.store(0);
+        slot.contended.store(0);
+        slot.wait.reset();
+        slot.hold.reset();
+        for (int s = 0; s < LOCK_STATS_SITES; s++) {
+            slot.sites[s].name[0] = '\0';
+            slot.sites[s].acquires.store(0);
+            slot.sites[s].contended.store(0);
+            slot.sites[s].wait_ns.store(0);
+            slot.sites[s].hold_ns.store(0);
+        }
+        return &slot;
+    }
+    return nullptr;
+}
+
+struct SiteTotals {
+    char name[LOCK_SITE_NAME];
+    uint64_t acquires, contended, wait_ns, hold_ns;
+};
+
+void lock_stats_print(LockStatsTable* table) {
+    static LatencyHistogram wait, hold;
+    wait.reset();
+    hold.reset();
+    
+    SiteTotals sites[LOCK_STATS_SLOTS * LOCK_STATS_SITES];
+    int site_count = 0;
+    int processes = 0;
+    uint64_t acquires = 0, contended = 0;
+    
+    for (int i = 0; i < LOCK_STATS_SLOTS; i++) {
+        LockStatsSlot& slot = table->slots[i];
+        if (slot.pid.load() == 0) continue;
+        
+        processes++;
+        acquires += slot.acquires.load();
+        contended += slot.contended.load();
+        wait.merge(slot.wait);
+        hold.merge(slot.hold);
+        
+        for (int s = 0; s < LOCK_STATS_SITES; s++) {
+            LockSiteStats& site = slot.sites[s];
+            uint64_t n = site.acquires.load();
+            if (n == 0) continue;
+            
+            int k = 0;
+            while (k < site_count && strncmp(sites[k].name, site.name, LOCK_SITE_NAME) != 0) k++;
+            if (k == site_count) {
+                memcpy(sites[k].name, site.name, LOCK_SITE_NAME);
+                sites[k].name[LOCK_SITE_NAME - 1] = '\0';
+                sites[k].acquires = sites[k].contended = sites[k].wait_ns = sites[k].hold_ns = 0;
+                site_count++;
+            }
+            sites[k].acquires += n;
+            sites[k].contended += site.contended.load();
+            sites[k].wait_ns += site.wait_ns.load();
+            sites[k].hold_ns += site.hold_ns.load();
+        }
+    }
+    
+    printf("Статистика блокировок: процессов %d, захватов %llu, с ожиданием %llu (%.1f%%)\n",
+           processes, (unsigned long long)acquires, (unsigned long long)contended,
+           acquires ? 100.0 * contended / acquires : 0.0);
+    printf("  ожидание  p50/p99/max: %llu / %llu / %llu нс\n",
+           (unsigned long long)wait.percentile(0.5), (unsigned long long)wait.percentile(0.99),
+           (unsigned long long)wait.percentile(1.0));
+    printf("  удержание p50/p99/max: %llu / %llu / %llu нс\n",
+           (unsigned long long)hold.percentile(0.5), (unsigned long long)hold.percentile(0.99),
+           (unsigned long long)hold.percentile(1.0));
+    
+    for (int k = 0; k < site_count; k++) {
+        printf("  %-24s захватов %8llu  с ожиданием %6llu  ожидание ср. %8llu нс  удержание ср. %10llu нс\n",
+               sites[k].name, (unsigned long long)sites[k].acquires, (unsigned long long)sites[k].contended,
+               (unsigned long long)(sites[k].wait_ns / sites[k].acquires),
+               (unsigned long long)(sites[k].hold_ns / sites[k].acquires));
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <atomic>
+#include <cstdint>
+
+// Гистограмма задержек в наносекундах: степени двойки, каждая разбита на
+// 4 под-интервала (точность ~25%). Счетчики атомарные, поэтому ее можно
+// класть в разделяемую память и писать из нескольких потоков.
+#define LATENCY_BUCKETS 128
+
+struct LatencyHistogram {
+    std::atomic<uint64_t> counts[LATENCY_BUCKETS];
+    
+    void record(uint64_t ns);
+    void merge(const LatencyHistogram& other);
+    void reset();
+    uint64_t total() const;
+    uint64_t percentile(double p) const;
+};
+
+// Инструментирование Mutex (собирается с -DCOUNTER_LOCK_STATS): каждый
+// процесс занимает слот в разделяемой памяти и копит в нем число захватов,
+// гистограммы ожидания и удержания и разбивку по местам вызова lock().
+#define LOCK_STATS_SLOTS 32
+#define LOCK_STATS_SITES 8
+#define LOCK_SITE_NAME 32
+
+struct LockSiteStats {
+    char name[LOCK_SITE_NAME];
+    std::atomic<uint64_t> acquires;
+    std::atomic<uint64_t> contended;
+    std::atomic<uint64_t> wait_ns;
+    std::atomic<uint64_t> hold_ns;
+};
+
+struct LockStatsSlot {
+    std::atomic<int64_t> pid;
+    std::atomic<uint64_t> acquires;
+    std::atomic<uint64_t> contended;
+    LatencyHistogram wait;
+    LatencyHistogram hold;
+    LockSiteStats sites[LOCK_STATS_SITES];
+};
+
+struct LockStatsTable {
+    LockStatsSlot slots[LOCK_STATS_SLOTS];
+};
+
+LockStatsSlot* lock_stats_claim(LockStatsTable* table, int64_t pid);
+void lock_stats_print(LockStatsTable* table);
+
+uint64_t monotonic_ns();
+
+#endif
@@ -0,0 +1,134 @@
+#include "supervisor.h"
+
+#ifndef _WIN32
+    #include <sys/wait.h>
+    #include <sys/syscall.h>
+    #include <poll.h>
+#endif
+
+#ifdef SYS_pidfd_open
+static int pidfd_open(platform_pid_t pid) {
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+}
+#else
+static int pidfd_open(platform_pid_t pid) {
+    errno = ENOSYS;
+    return -1;
+}
+#endif
+
+ChildSupervisor::ChildSupervisor(EventLoop* loop) : loop(loop), use_pidfd(false) {
+#if defined(__linux__)
+    int fd = pidfd_open(get_current_pid());
+    if (fd != -1) {
+        close(fd);
+        use_pidfd = true;
+    }
+#endif
+    if (!use_pidfd) loop->add_timer("reap", 500, true, [this] { poll(); });
+}
+
+ChildSupervisor::~ChildSupervisor() {
+    for (std::map<platform_pid_t, Child>::iterator it = children.begin(); it != children.end(); ++it) {
+#ifdef _WIN32
+        CloseHandle(it->second.handle);
+#else
+        if (it->second.fd != -1) {
+#ifdef __linux__
+            loop->remove_fd(it->second.fd);
+#endif
+            close(it->second.fd);
+        }
+#endif
+    }
+}
+
+bool ChildSupervisor::watch(platform_pid_t pid, ExitCallback on_exit) {
+    if (pid == 0 || children.count(pid)) return false;
+    
+    Child child;
+    child.started_ns = monotonic_ns();
+    child.on_exit = on_exit;
+    
+#ifdef _WIN32
+    child.handle = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (child.handle == NULL) return false;
+    children[pid] = child;
+#else
+    child.fd = -1;
+    if (use_pidfd) {
+        child.fd = pidfd_open(pid);
+        if (child.fd == -1) return false;
+    } else if (kill(pid, 0) != 0 && errno == ESRCH) {
+        return false;
+    }
+    children[pid] = child;
+    
+#ifdef __linux__
+    if (child.fd != -1) {
+        int fd = child.fd;
+        loop->add_fd(fd, [this, pid, fd] {
+            struct pollfd ready = { fd, POLLIN, 0 };
+            if (::poll(&ready, 1, 0) == 1) reap(pid, true);
+        });
+    }
+#endif
+#endif
+    return true;
+}
+
+bool ChildSupervisor::watching(platform_pid_t pid) const {
+    return pid != 0 && children.count(pid) != 0;
+}
+
+size_t ChildSupervisor::size() const {
+    return children.size();
+}
+
+void ChildSupervisor::poll() {
+    std::vector<platform_pid_t> pids;
+    for (std::map<platform_pid_t, Child>::iterator it = children.begin(); it != children.end(); ++it) {
+        pids.push_back(it->first);
+    }
+    for (platform_pid_t pid : pids) reap(pid, false);
+}
+
+// exited=true: pidfd уже сообщил о завершении. Для чужого процесса
+// waitpid недоступен, а kill(pid, 0) отвечает успехом, пока зомби не
+// снят его родителем, поэтому в этом случае верим pidfd.
+void ChildSupervisor::reap(platform_pid_t pid, bool exited) {
+    std::map<platform_pid_t, Child>::iterator it = children.find(pid);
+    if (it == children.end()) return;
+    Child& child = it->second;
+    int status = -1;
+    
+#ifdef _WIN32
+    if (WaitForSingleObject(child.handle, 0) != WAIT_OBJECT_0) return;
+    DWORD code;
+    if (GetExitCodeProcess(child.handle, &code)) status = (int)code;
+    CloseHandle(child.handle);
+#else
+    int raw;
+    pid_t done = waitpid(pid, &raw, WNOHANG);
+    if (done == 0 || (done == -1 && errno == EINTR)) return;
+    if (done == pid) {
+        if (WIFEXITED(raw)) status = WEXITSTATUS(raw);
+        else if (WIFSIGNALED(raw)) status = 128 + WTERMSIG(raw);
+    } else if (errno == ECHILD && !exited && kill(pid, 0) == 0) {
+        // Не наш процесс и еще жив: его снимет собственный родитель.
+        return;
+    }
+    
+    if (child.fd != -1) {
+#ifdef __linux__
+        loop->remove_fd(child.fd);
+#endif
+        close(child.fd);
+    }
+#endif
+    
+    int64_t runtime_ms = (int64_t)((monotonic_ns() - child.started_ns) / 1000000ull);
+    ExitCallback on_exit = child.on_exit;
+    children.erase(it);
+    on_exit(pid, status, runtime_ms);
+}
@@ -0,0 +1,49 @@
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include "platform.h"
+#include "event_loop.h"
+#include <functional>
+#include <map>
+
+// Наблюдение за дочерними процессами лидера. В Linux на каждый процесс
+// открывается pidfd и добавляется в цикл событий: он становится читаемым
+// в момент завершения, процесс сразу снимается waitpid и вызывается
+// обработчик. Пока зомби не снят, его PID не может быть переиспользован.
+// Без pidfd_open (старое ядро, другие POSIX) те же действия выполняет
+// таймер "reap" через waitpid(WNOHANG), в Windows - через описатель
+// процесса.
+//
+// status - код выхода, 128+N при завершении сигналом N или -1, если
+// процесс не наш (унаследован от прежнего лидера) и статус недоступен.
+class ChildSupervisor {
+public:
+    typedef std::function<void(platform_pid_t pid, int status, int64_t runtime_ms)> ExitCallback;
+    
+    explicit ChildSupervisor(EventLoop* loop);
+    ~ChildSupervisor();
+    
+    bool watch(platform_pid_t pid, ExitCallback on_exit);
+    bool watching(platform_pid_t pid) const;
+    size_t size() const;
+    void poll();
+    
+private:
+    struct Child {
+        uint64_t started_ns;
+        ExitCallback on_exit;
+#ifdef _WIN32
+        HANDLE handle;
+#else
+        int fd;
+#endif
+    };
+    
+    EventLoop* loop;
+    std::map<platform_pid_t, Child> children;
+    bool use_pidfd;
+    
+    void reap(platform_pid_t pid, bool exited);
+};
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef TESTS_CHECK_H
+#define TESTS_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Проверки без тестового фреймворка: первая неудачная печатает место и
+// условие и завершает тест с кодом 1.
+#define CHECK(cond)                                                                      \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);     \
+            exit(1);                                                                     \
+        }                                                                                \
+    } while (0)
+
+inline std::string read_file(const std::string& path) {
+    std::string data;
+    FILE* f = fopen(path.c_str(), "rb");
+    if (!f) return data;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.append(buf, n);
+    fclose(f);
+    return data;
+}
+
+inline size_t count_occurrences(const std::string& text, const std::string& needle) {
+    size_t count = 0;
+    for (size_t pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) count++;
+    return count;
+}
+
+#endif
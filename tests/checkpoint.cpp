@@ -0,0 +1,90 @@
+// Контрольные точки (user-015): запись и чтение, откат к предыдущей
+// записи при оборванной странице и восстановление значения новым сегментом
+// после аварийного завершения процесса, который их писал.
+#include "platform.h"
+#include "counter.h"
+#include "persist.h"
+#include "counter_policy.h"
+#include "check.h"
+#include <string>
+#include <sys/wait.h>
+
+static std::string path;
+
+static void test_round_trip() {
+    CheckpointRecord record;
+    {
+        CheckpointFile file(path.c_str());
+        CHECK(!file.load(&record));
+        file.store(10);
+        file.store(20);
+        CHECK(file.load(&record));
+        CHECK(record.value == 20);
+        CHECK(record.seq == 2);
+    }
+    CheckpointFile reopened(path.c_str());
+    CHECK(reopened.load(&record));
+    CHECK(record.value == 20);
+}
+
+// Запись seq 2 лежит в странице 0: портим ее значение, как при обрыве
+// записи посреди страницы.
+static void test_torn_page() {
+    int fd = open(path.c_str(), O_RDWR);
+    CHECK(fd != -1);
+    int64_t garbage = 12345;
+    CHECK(pwrite(fd, &garbage, sizeof(garbage), offsetof(CheckpointRecord, value)) == (ssize_t)sizeof(garbage));
+    close(fd);
+    
+    CheckpointFile file(path.c_str());
+    CheckpointRecord record;
+    CHECK(file.load(&record));
+    CHECK(record.value == 10);
+    CHECK(record.seq == 1);
+    
+    file.store(30);
+    CHECK(file.load(&record));
+    CHECK(record.value == 30);
+}
+
+static void test_crash_recovery() {
+    std::string shm_name = "/counter_test_checkpoint_" + std::to_string(getpid());
+    setenv("COUNTER_PERSIST", path.c_str(), 1);
+    remove(path.c_str());
+    
+    pid_t child = fork();
+    if (child == 0) {
+        SharedMemory shm(shm_name.c_str(), FileStorage::on_create);
+        Mutex mutex(&shm);
+        counter_set(shm.segment(), &mutex, 777);
+        Checkpointer checkpointer(shm.segment(), path.c_str(), 10);
+        while (shm.segment()->metrics.checkpoints.load() == 0) sleep_ms(1);
+        _exit(0);   // без finish(): процесс упал
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    
+    // Перезагрузка: сегмента в /dev/shm больше нет.
+    shm_unlink(shm_name.c_str());
+    SharedMemory shm(shm_name.c_str(), FileStorage::on_create);
+    CHECK(counter_read(shm.segment()) == 777);
+    CheckpointRecord record;
+    CHECK(FileStorage::restored(&record));
+    CHECK(record.value == 777);
+    
+    shm_unlink(shm_name.c_str());
+}
+
+int main() {
+    path = "counter_test_checkpoint_" + std::to_string(getpid()) + ".ckpt";
+    remove(path.c_str());
+    
+    test_round_trip();
+    test_torn_page();
+    test_crash_recovery();
+    
+    remove(path.c_str());
+    printf("checkpoint: ok\n");
+    return 0;
+}
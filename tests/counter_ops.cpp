@@ -0,0 +1,100 @@
+// Составные операции (user-016): пачка применяется целиком, set_epoch
+// растет ровно на единицу на пачку с SET/CLAMP, а отмена ScopedTransform
+// сохраняет инкременты других процессов и пропускается после set. Все
+// проверки - в обычном и шардированном сегменте.
+#include "platform.h"
+#include "counter.h"
+#include "check.h"
+#include <string>
+#include <sys/wait.h>
+
+#define CHILD_INCREMENTS 10000
+
+static void test_pure_ops() {
+    CounterOp ops[] = { counter_op(OP_ADD, 3), counter_op(OP_MUL, 4), counter_op(OP_DIV, 3),
+                        counter_op(OP_CLAMP, 0, 10) };
+    CHECK(counter_apply_ops(ops, 3, 5) == 10);
+    CHECK(counter_apply_ops(ops, 4, 5) == 10);
+    CHECK(counter_apply_ops(ops, 4, -50) == 0);
+    
+    CounterOp div_zero = counter_op(OP_DIV, 0);
+    CHECK(counter_apply_ops(&div_zero, 1, 7) == 7);
+}
+
+static void test_batch(SharedSegment* seg, Mutex* mutex) {
+    counter_set(seg, mutex, 100);
+    CounterOp ops[] = { counter_op(OP_ADD, 5), counter_op(OP_MUL, 2) };
+    CounterResult result = counter_apply(seg, mutex, ops, 2);
+    CHECK(result.applied);
+    CHECK(result.before == 100);
+    CHECK(result.after == 210);
+    CHECK(counter_read(seg) == 210);
+}
+
+static void test_set_epoch(SharedSegment* seg, Mutex* mutex) {
+    uint64_t epoch = seg->counter.set_epoch.load();
+    CounterOp add = counter_op(OP_ADD, 1);
+    CHECK(counter_apply(seg, mutex, &add, 1, epoch).applied);
+    CHECK(seg->counter.set_epoch.load() == epoch);
+    
+    counter_set(seg, mutex, 10);
+    CHECK(seg->counter.set_epoch.load() == epoch + 1);
+    CHECK(!counter_apply(seg, mutex, &add, 1, epoch).applied);
+    CHECK(counter_read(seg) == 10);
+    
+    // Пачка с SET при совпадающей эпохе проходит и увеличивает ее один раз.
+    CounterOp reset[] = { counter_op(OP_SET, 40), counter_op(OP_ADD, 2) };
+    CounterResult result = counter_apply(seg, mutex, reset, 2, epoch + 1);
+    CHECK(result.applied);
+    CHECK(result.after == 42);
+    CHECK(seg->counter.set_epoch.load() == epoch + 2);
+}
+
+static void test_transform_keeps_increments(SharedSegment* seg, Mutex* mutex) {
+    counter_set(seg, mutex, 1000);
+    CounterOp twice = counter_op(OP_MUL, 2);
+    ScopedTransform transform(seg, mutex, &twice, 1);
+    CHECK(transform.value() == 2000);
+    
+    pid_t child = fork();
+    if (child == 0) {
+        for (int i = 0; i < CHILD_INCREMENTS; i++) counter_add(seg, 1);
+        _exit(0);
+    }
+    waitpid(child, nullptr, 0);
+    
+    CHECK(transform.revert());
+    CHECK(counter_read(seg) == 1000 + CHILD_INCREMENTS);
+}
+
+static void test_transform_after_set(SharedSegment* seg, Mutex* mutex) {
+    counter_set(seg, mutex, 7);
+    CounterOp twice = counter_op(OP_MUL, 2);
+    ScopedTransform transform(seg, mutex, &twice, 1);
+    counter_set(seg, mutex, 50);
+    CHECK(!transform.revert());
+    CHECK(counter_read(seg) == 50);
+}
+
+static void run_segment(bool sharded) {
+    std::string shm_name = "/counter_test_ops_" + std::to_string(getpid()) + (sharded ? "_sharded" : "");
+    setenv("COUNTER_SHARDED", sharded ? "1" : "0", 1);
+    SharedMemory shm(shm_name.c_str());
+    Mutex mutex(&shm);
+    CHECK(shm.segment()->counter.sharded == sharded);
+    
+    test_batch(shm.segment(), &mutex);
+    test_set_epoch(shm.segment(), &mutex);
+    test_transform_keeps_increments(shm.segment(), &mutex);
+    test_transform_after_set(shm.segment(), &mutex);
+    
+    shm_unlink(shm_name.c_str());
+}
+
+int main() {
+    test_pure_ops();
+    run_segment(false);
+    run_segment(true);
+    printf("counter_ops: ok\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Seqlock над полями SharedCounter (user-014): снимок согласован при
+// параллельной записи, а запись, оборванная смертью писателя, видна как
+// несогласованная до тех пор, пока следующий писатель не заберет ее.
+#include "platform.h"
+#include "counter.h"
+#include "check.h"
+#include <string>
+#include <sys/wait.h>
+
+#define WRITES 200000
+
+static void write_state(SharedCounter* sc, int64_t v) {
+    counter_write_begin(sc);
+    sc->leader_pid.store((platform_pid_t)v);
+    sc->last_leader_activity.store((time_t)v);
+    counter_write_end(sc);
+}
+
+static void test_round_trip(SharedSegment* seg) {
+    write_state(&seg->counter, 4242);
+    counter_add(seg, 5);
+    int64_t value = counter_read(seg);
+    
+    CounterSnapshot snap;
+    counter_snapshot(seg, &snap);
+    CHECK(snap.consistent);
+    CHECK(snap.leader_pid == 4242);
+    CHECK(snap.last_leader_activity == 4242);
+    CHECK(snap.value == value);
+}
+
+static void test_concurrent_writer(SharedSegment* seg) {
+    pid_t writer = fork();
+    if (writer == 0) {
+        for (int64_t i = 1; i <= WRITES; i++) write_state(&seg->counter, i);
+        _exit(0);
+    }
+    
+    int consistent = 0;
+    int status = 0;
+    while (waitpid(writer, &status, WNOHANG) == 0) {
+        CounterSnapshot snap;
+        counter_snapshot(seg, &snap);
+        if (!snap.consistent) continue;
+        CHECK((int64_t)snap.leader_pid == (int64_t)snap.last_leader_activity);
+        consistent++;
+    }
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    CHECK(consistent > 0);
+    CHECK((seg->counter.state_seq.load() & 1) == 0);
+}
+
+static void test_dead_writer(SharedSegment* seg) {
+    SharedCounter* sc = &seg->counter;
+    pid_t writer = fork();
+    if (writer == 0) {
+        counter_write_begin(sc);
+        sc->leader_pid.store(1);
+        _exit(0);   // умер посреди записи
+    }
+    waitpid(writer, nullptr, 0);
+    CHECK(sc->state_seq.load() & 1);
+    CHECK(sc->state_writer.load() == (int64_t)writer);
+    
+    CounterSnapshot snap;
+    counter_snapshot(seg, &snap);
+    CHECK(!snap.consistent);
+    
+    write_state(sc, 7);
+    CHECK((sc->state_seq.load() & 1) == 0);
+    CHECK(sc->state_writer.load() == 0);
+    counter_snapshot(seg, &snap);
+    CHECK(snap.consistent);
+    CHECK(snap.leader_pid == 7);
+    CHECK(snap.last_leader_activity == 7);
+}
+
+int main() {
+    std::string shm_name = "/counter_test_snapshot_" + std::to_string(getpid());
+    SharedMemory shm(shm_name.c_str());
+    
+    test_round_trip(shm.segment());
+    test_concurrent_writer(shm.segment());
+    test_dead_writer(shm.segment());
+    
+    shm_unlink(shm_name.c_str());
+    printf("counter_snapshot: ok\n");
+    return 0;
+}
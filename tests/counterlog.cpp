@@ -0,0 +1,179 @@
+// Двоичный лог и counterlog (user-022): события, записанные через LogRing,
+// читаются из файла без потерь, экспорт совпадает с текстовым форматом, а
+// запросы по времени (с поиском границ и с --scan), PID, типу и значению
+// находят ровно то же, что перебор. Путь к counterlog - в COUNTERLOG.
+#include "platform.h"
+#include "logger.h"
+#include "check.h"
+#include <string>
+#include <vector>
+
+#define BASE_NS 1700000000000000000ULL
+#define SECOND_NS 1000000000ULL
+#define EVENTS 40
+
+static std::string counterlog;
+
+static std::string run(const std::string& args) {
+    std::string command = counterlog + " " + args;
+    FILE* pipe = popen(command.c_str(), "r");
+    CHECK(pipe != nullptr);
+    std::string output;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pipe)) > 0) output.append(buf, n);
+    CHECK(pclose(pipe) == 0);
+    return output;
+}
+
+static std::string export_text(const std::vector<LogEvent>& events) {
+    std::string text;
+    char ts[TIMESTAMP_SIZE];
+    char line[512];
+    for (const LogEvent& e : events) {
+        format_timestamp_ns(e.ts_ns, ts, sizeof(ts));
+        text.append(line, log_event_format(e, ts, line, sizeof(line)));
+        text += '\n';
+    }
+    return text;
+}
+
+static std::vector<LogEvent> read_events(const std::string& path) {
+    std::string data = read_file(path);
+    CHECK(data.size() % sizeof(LogEvent) == 0);
+    std::vector<LogEvent> events(data.size() / sizeof(LogEvent));
+    if (!events.empty()) memcpy(events.data(), data.data(), data.size());
+    return events;
+}
+
+// Запись через log_event -> LogRing -> выгружающий процесс.
+static void test_writer_round_trip(const std::string& bin) {
+    std::string shm_name = "/counter_test_counterlog_" + std::to_string(getpid());
+    SharedMemory shm(shm_name.c_str());
+    log_attach_ring(&shm.segment()->log_ring);
+    log_set_drainer(true);
+    for (int i = 0; i < EVENTS; i++) log_event(LOG_EV_COUNTER, ROLE_NONE, i, 0, 0);
+    log_event(LOG_EV_MANUAL_SET, ROLE_NONE, -5);
+    log_event(LOG_EV_EXIT, ROLE_CHILD1, 4321, 250, 3);
+    log_set_drainer(false);
+    log_shutdown();
+    shm_unlink(shm_name.c_str());
+    
+    std::vector<LogEvent> events = read_events(bin);
+    CHECK(events.size() == EVENTS + 2);
+    for (int i = 0; i < EVENTS; i++) {
+        CHECK(events[i].type == LOG_EV_COUNTER);
+        CHECK(events[i].value == i);
+        CHECK(events[i].pid == (int32_t)getpid());
+    }
+    CHECK(events[EVENTS].type == LOG_EV_MANUAL_SET && events[EVENTS].value == -5);
+    const LogEvent& exit_event = events[EVENTS + 1];
+    CHECK(exit_event.type == LOG_EV_EXIT && exit_event.role == ROLE_CHILD1);
+    CHECK(exit_event.value == 4321 && exit_event.arg == 250 && exit_event.aux == 3);
+    
+    CHECK(run(bin) == export_text(events));
+}
+
+struct Filter {
+    uint64_t from;
+    uint64_t to;
+    int32_t pid;
+    int type;
+    int64_t min;
+    int64_t max;
+};
+
+static std::vector<LogEvent> brute_force(const std::vector<LogEvent>& events, const Filter& f) {
+    std::vector<LogEvent> found;
+    for (const LogEvent& e : events) {
+        if (e.ts_ns < f.from || e.ts_ns > f.to || e.value < f.min || e.value > f.max) continue;
+        if ((f.pid && e.pid != f.pid) || (f.type != LOG_EV_NONE && e.type != f.type)) continue;
+        found.push_back(e);
+    }
+    return found;
+}
+
+static std::string seconds_arg(uint64_t ns) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%llu.%03llu", (unsigned long long)(ns / SECOND_NS),
+             (unsigned long long)(ns % SECOND_NS / 1000000));
+    return buf;
+}
+
+static void check_query(const std::string& file, const std::vector<LogEvent>& events, const Filter& f,
+                        const std::string& args) {
+    std::string expected = export_text(brute_force(events, f));
+    CHECK(run(args + " " + file) == expected);
+    CHECK(run("--scan " + args + " " + file) == expected);
+}
+
+// Синтетический файл: событие в секунду, два PID, значения по кругу;
+// запись 21 на 0.5 с старше предыдущей (порядок нарушен в пределах
+// TIME_SLACK_NS). Границы запросов не совпадают с метками событий:
+// counterlog читает секунды как double.
+static void test_queries(const std::string& file) {
+    std::vector<LogEvent> events(EVENTS);
+    for (int i = 0; i < EVENTS; i++) {
+        LogEvent& e = events[i];
+        memset(&e, 0, sizeof(e));
+        e.ts_ns = BASE_NS + i * SECOND_NS;
+        e.value = (i * 7) % 50;
+        e.pid = i % 2 ? 200 : 100;
+        e.type = i % 3 ? LOG_EV_COUNTER : LOG_EV_MANUAL_SET;
+    }
+    events[21].ts_ns = BASE_NS + 20 * SECOND_NS - SECOND_NS / 2;
+    
+    FILE* f = fopen(file.c_str(), "wb");
+    CHECK(f != nullptr);
+    CHECK(fwrite(events.data(), sizeof(LogEvent), events.size(), f) == events.size());
+    fclose(f);
+    
+    CHECK(run(file) == export_text(events));
+    
+    Filter all = { 0, UINT64_MAX, 0, LOG_EV_NONE, INT64_MIN, INT64_MAX };
+    Filter window = all;
+    window.from = BASE_NS + 9 * SECOND_NS + SECOND_NS / 2;
+    window.to = BASE_NS + 19 * SECOND_NS + SECOND_NS * 7 / 10;
+    check_query(file, events, window, "--from " + seconds_arg(window.from) + " --to " + seconds_arg(window.to));
+    CHECK(brute_force(events, window).size() == 11);   // 10..19 и запись 21
+    
+    Filter late = all;
+    late.from = BASE_NS + 19 * SECOND_NS + SECOND_NS * 6 / 10;
+    check_query(file, events, late, "--from " + seconds_arg(late.from));
+    
+    Filter by_pid = all;
+    by_pid.pid = 200;
+    by_pid.type = LOG_EV_COUNTER;
+    by_pid.min = 10;
+    by_pid.max = 30;
+    check_query(file, events, by_pid, "--pid 200 --type counter --min 10 --max 30");
+    
+    size_t sets = brute_force(events, Filter{ 0, UINT64_MAX, 0, LOG_EV_MANUAL_SET, INT64_MIN, INT64_MAX }).size();
+    std::string counts = run("--count " + file);
+    char expected[128];
+    snprintf(expected, sizeof(expected), "всего: %d из %d\n", EVENTS, EVENTS);
+    CHECK(counts.find(expected) != std::string::npos);
+    snprintf(expected, sizeof(expected), "%-16s %zu\n", log_event_type_name(LOG_EV_MANUAL_SET), sets);
+    CHECK(counts.find(expected) != std::string::npos);
+}
+
+int main() {
+    const char* path = getenv("COUNTERLOG");
+    counterlog = path && *path ? path : "build/counterlog";
+    
+    std::string base = "counter_test_counterlog_" + std::to_string(getpid());
+    std::string text = base + ".txt";
+    std::string bin = base + ".bin";
+    setenv("COUNTER_LOG_FILE", text.c_str(), 1);
+    setenv("COUNTER_LOG_FORMAT", "binary", 1);
+    CHECK(log_binary_filename() == bin);
+    
+    test_writer_round_trip(bin);
+    test_queries(base + "_synthetic.bin");
+    
+    remove(text.c_str());
+    remove(bin.c_str());
+    remove((base + "_synthetic.bin").c_str());
+    printf("counterlog: ok\n");
+    return 0;
+}
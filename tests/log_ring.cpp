@@ -0,0 +1,93 @@
+// Общий LogRing (user-004): записи дочерних процессов доходят до файла
+// лидера ровно по одному разу, переполнение считается, а слот, который
+// писатель зарезервировал и не опубликовал (умер), пропускается.
+#include "platform.h"
+#include "logger.h"
+#include "check.h"
+#include <string>
+#include <sys/wait.h>
+
+#define CHILDREN 4
+#define LINES_PER_CHILD 200
+
+static std::string log_file;
+
+static void drain_and_close() {
+    log_set_drainer(true);
+    log_set_drainer(false);
+}
+
+static void test_round_trip(LogRing* ring) {
+    for (int c = 0; c < CHILDREN; c++) {
+        if (fork() == 0) {
+            char line[64];
+            for (int i = 0; i < LINES_PER_CHILD; i++) {
+                snprintf(line, sizeof(line), "child %d line %d", c, i);
+                log_message(line);
+            }
+            _exit(0);
+        }
+    }
+    log_set_drainer(true);
+    while (wait(nullptr) > 0) {}
+    log_set_drainer(false);
+    
+    std::string text = read_file(log_file);
+    char line[64];
+    for (int c = 0; c < CHILDREN; c++) {
+        for (int i = 0; i < LINES_PER_CHILD; i++) {
+            snprintf(line, sizeof(line), "child %d line %d\n", c, i);
+            CHECK(count_occurrences(text, line) == 1);
+        }
+    }
+    CHECK(ring->tail.load() == ring->head.load());
+    CHECK(text.find("WARNING") == std::string::npos);
+}
+
+static void test_overflow(LogRing* ring) {
+    remove(log_file.c_str());
+    for (int i = 0; i < LOG_RING_SLOTS + 5; i++) log_message("overflow line");
+    CHECK(ring->overflow.load() == 5);
+    drain_and_close();
+    
+    std::string text = read_file(log_file);
+    CHECK(count_occurrences(text, "overflow line\n") == LOG_RING_SLOTS);
+    CHECK(text.find("shared log ring overflow, 5 lines dropped") != std::string::npos);
+}
+
+static void test_stuck_slot(LogRing* ring) {
+    remove(log_file.c_str());
+    ring->head.fetch_add(1);   // писатель зарезервировал слот и умер
+    log_message("after stuck slot");
+    log_set_drainer(true);
+    sleep_ms(1500);   // дольше LOG_RING_STUCK_NS (1 с)
+    log_message("after skip");
+    sleep_ms(500);
+    log_set_drainer(false);
+    
+    std::string text = read_file(log_file);
+    CHECK(count_occurrences(text, "after stuck slot\n") == 1);
+    CHECK(count_occurrences(text, "after skip\n") == 1);
+    CHECK(text.find("not published by writer, 1 lines lost") != std::string::npos);
+    CHECK(ring->tail.load() == ring->head.load());
+}
+
+int main() {
+    std::string shm_name = "/counter_test_ring_" + std::to_string(getpid());
+    log_file = "counter_test_ring_" + std::to_string(getpid()) + ".txt";
+    setenv("COUNTER_LOG_FILE", log_file.c_str(), 1);
+    
+    SharedMemory shm(shm_name.c_str());
+    LogRing* ring = &shm.segment()->log_ring;
+    log_attach_ring(ring);
+    
+    test_round_trip(ring);
+    test_overflow(ring);
+    test_stuck_slot(ring);
+    
+    log_shutdown();
+    remove(log_file.c_str());
+    shm_unlink(shm_name.c_str());
+    printf("log_ring: ok\n");
+    return 0;
+}
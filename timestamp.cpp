@@ -0,0 +1,174 @@
+#include "timestamp.h"
+#include "platform.h"
+
+Timestamp get_current_timestamp() {
+    Timestamp ts = {};
+    
+#ifdef _WIN32
+    struct _timeb timebuffer;
+    _ftime64(&timebuffer);
+    struct tm tm_struct;
+    localtime_s(&tm_struct, &timebuffer.time);
+    
+    ts.year = tm_struct.tm_year + 1900;
+    ts.month = tm_struct.tm_mon + 1;
+    ts.day = tm_struct.tm_mday;
+    ts.hour = tm_struct.tm_hour;
+    ts.minute = tm_struct.tm_min;
+    ts.second = tm_struct.tm_sec;
+    ts.millisecond = timebuffer.millitm;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    struct tm tm_struct;
+    localtime_r(&tv.tv_sec, &tm_struct);
+    
+    ts.year = tm_struct.tm_year + 1900;
+    ts.month = tm_struct.tm_mon + 1;
+    ts.day = tm_struct.tm_mday;
+    ts.hour = tm_struct.tm_hour;
+    ts.minute = tm_struct.tm_min;
+    ts.second = tm_struct.tm_sec;
+    ts.millisecond = tv.tv_usec / 1000;
+#endif
+    
+    return ts;
+}
+
+std::string format_timestamp(const Timestamp& ts) {
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), 
+            "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+            ts.year, ts.month, ts.day,
+            ts.hour, ts.minute, ts.second,
+            ts.millisecond);
+    return std::string(buffer);
+}
+
+#ifndef _WIN32
+struct TimestampCache {
+    time_t second;
+    time_t offset_valid_until;
+    long utc_offset;
+    char prefix[20];
+};
+
+static thread_local TimestampCache ts_cache = { -1, 0, 0, {0} };
+
+static clockid_t timestamp_clock() {
+#ifdef CLOCK_REALTIME_COARSE
+    static const clockid_t id = env_int("COUNTER_COARSE_CLOCK", 0) ? CLOCK_REALTIME_COARSE : CLOCK_REALTIME;
+    return id;
+#else
+    return CLOCK_REALTIME;
+#endif
+}
+
+static inline void put_digits(char* p, int value, int width) {
+    for (int i = width - 1; i >= 0; i--) {
+        p[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+}
+
+static void refresh_timestamp_prefix(TimestampCache& c, time_t sec) {
+    if (sec >= c.offset_valid_until || sec < c.offset_valid_until - 900) {
+        struct tm tm_struct;
+        localtime_r(&sec, &tm_struct);
+        c.utc_offset = tm_struct.tm_gmtoff;
+        c.offset_valid_until = sec - sec % 900 + 900;
+    }
+    
+    int64_t local = (int64_t)sec + c.utc_offset;
+    int64_t days = local / 86400;
+    int64_t day_secs = local % 86400;
+    if (day_secs < 0) {
+        day_secs += 86400;
+        days--;
+    }
+    
+    // civil_from_days (H. Hinnant)
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    int day = (int)(doy - (153 * mp + 2) / 5 + 1);
+    int month = (int)(mp < 10 ? mp + 3 : mp - 9);
+    int year = (int)(yoe + era * 400 + (month <= 2));
+    
+    char* p = c.prefix;
+    put_digits(p, year, 4);       p[4] = '-';
+    put_digits(p + 5, month, 2);  p[7] = '-';
+    put_digits(p + 8, day, 2);    p[10] = ' ';
+    put_digits(p + 11, (int)(day_secs / 3600), 2);       p[13] = ':';
+    put_digits(p + 14, (int)(day_secs / 60 % 60), 2);    p[16] = ':';
+    put_digits(p + 17, (int)(day_secs % 60), 2);
+    c.second = sec;
+}
+#endif
+
+size_t format_current_timestamp(char* buf, size_t size) {
+    if (size < 24) {
+        if (size > 0) buf[0] = '\0';
+        return 0;
+    }
+    
+#ifdef _WIN32
+    std::string formatted = format_timestamp(get_current_timestamp());
+    memcpy(buf, formatted.c_str(), formatted.size() + 1);
+    return formatted.size();
+#else
+    struct timespec now;
+    clock_gettime(timestamp_clock(), &now);
+    
+    TimestampCache& c = ts_cache;
+    if (now.tv_sec != c.second) refresh_timestamp_prefix(c, now.tv_sec);
+    
+    memcpy(buf, c.prefix, 19);
+    buf[19] = '.';
+    put_digits(buf + 20, (int)(now.tv_nsec / 1000000), 3);
+    buf[23] = '\0';
+    return 23;
+#endif
+}
+
+uint64_t realtime_ns() {
+#ifdef _WIN32
+    FILETIME ft;
+    GetSystemTimePreciseAsFileTime(&ft);
+    uint64_t ticks = ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    return (ticks - 116444736000000000ULL) * 100;
+#else
+    struct timespec now;
+    clock_gettime(timestamp_clock(), &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+size_t format_timestamp_ns(uint64_t ns, char* buf, size_t size) {
+    if (size < 24) {
+        if (size > 0) buf[0] = '\0';
+        return 0;
+    }
+    
+    time_t sec = (time_t)(ns / 1000000000ULL);
+    int ms = (int)(ns / 1000000 % 1000);
+#ifdef _WIN32
+    struct tm local;
+    localtime_s(&local, &sec);
+    return (size_t)snprintf(buf, size, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+                            local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+                            local.tm_hour, local.tm_min, local.tm_sec, ms);
+#else
+    TimestampCache& c = ts_cache;
+    if (sec != c.second) refresh_timestamp_prefix(c, sec);
+    
+    memcpy(buf, c.prefix, 19);
+    buf[19] = '.';
+    put_digits(buf + 20, ms, 3);
+    buf[23] = '\0';
+    return 23;
+#endif
+}
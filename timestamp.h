@@ -0,0 +1,29 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Метки времени лога. Отдельно от platform.cpp, чтобы утилиты чтения
+// лога (counterlog) не линковали остальной код счетчика.
+struct Timestamp {
+    int year, month, day;
+    int hour, minute, second, millisecond;
+};
+
+Timestamp get_current_timestamp();
+std::string format_timestamp(const Timestamp& ts);
+
+// "YYYY-MM-DD HH:MM:SS.mmm" без аллокаций: префикс до секунд кэшируется
+// в потоке и пересчитывается раз в секунду, localtime_r вызывается только
+// для обновления смещения часового пояса (раз в 15 минут).
+// COUNTER_COARSE_CLOCK=1 включает CLOCK_REALTIME_COARSE.
+#define TIMESTAMP_SIZE 32
+size_t format_current_timestamp(char* buf, size_t size);
+// То же для заданного момента (нс от эпохи, CLOCK_REALTIME), например
+// для записей двоичного лога.
+size_t format_timestamp_ns(uint64_t ns, char* buf, size_t size);
+uint64_t realtime_ns();
+
+#endif
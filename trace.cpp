@@ -0,0 +1,206 @@
+#include "trace.h"
+
+#if defined(__linux__)
+    #include <sys/syscall.h>
+#endif
+
+TraceRing* trace_ring = nullptr;
+
+static const char* const TRACE_NAMES[TRACE_TYPES] = {
+    "none", "lock_wait", "lock_hold", "increment", "apply", "set", "spawn", "child1", "child2", "log_flush"
+};
+
+static const char* const TRACE_CATEGORIES[TRACE_TYPES] = {
+    "", "lock", "lock", "counter", "counter", "counter", "spawn", "job", "job", "log"
+};
+
+static TraceSegment* map_trace_segment(bool create) {
+    size_t size = sizeof(TraceSegment);
+#ifdef _WIN32
+    HANDLE handle = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                                (DWORD)((uint64_t)size >> 32), (DWORD)size, TRACE_SHM_NAME)
+                           : OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, TRACE_SHM_NAME);
+    if (handle == NULL) return nullptr;
+    // Отображение удерживает объект и после закрытия описателя.
+    void* ptr = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    CloseHandle(handle);
+    return (TraceSegment*)ptr;
+#else
+    int fd = shm_open(TRACE_SHM_NAME, create ? O_CREAT | O_RDWR : O_RDWR, 0666);
+    if (fd == -1) return nullptr;
+    
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (st.st_size < (off_t)size && (!create || ftruncate(fd, size) == -1))) {
+        close(fd);
+        return nullptr;
+    }
+    
+    void* ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    return ptr == MAP_FAILED ? nullptr : (TraceSegment*)ptr;
+#endif
+}
+
+static void unmap_trace_segment(TraceSegment* seg) {
+#ifdef _WIN32
+    UnmapViewOfFile(seg);
+#else
+    munmap(seg, sizeof(TraceSegment));
+#endif
+}
+
+static uint32_t current_tid() {
+    static thread_local uint32_t tid = 0;
+    if (tid == 0) {
+#ifdef _WIN32
+        tid = (uint32_t)GetCurrentThreadId();
+#elif defined(__linux__)
+        tid = (uint32_t)syscall(SYS_gettid);
+#else
+        tid = (uint32_t)(uintptr_t)pthread_self();
+#endif
+    }
+    return tid;
+}
+
+// Кольцо умершего процесса, занятое раньше остальных.
+static TraceRing* oldest_dead_ring(TraceSegment* seg) {
+    TraceRing* oldest = nullptr;
+    for (int i = 0; i < TRACE_RINGS; i++) {
+        TraceRing& ring = seg->rings[i];
+        int64_t pid = ring.pid.load(std::memory_order_acquire);
+        if (pid <= 0 || is_process_alive((platform_pid_t)pid)) continue;
+        if (!oldest || ring.attached_ns < oldest->attached_ns) oldest = &ring;
+    }
+    return oldest;
+}
+
+void trace_attach(const char* label) {
+    if (trace_ring || env_int("COUNTER_TRACE", 0) == 0) return;
+    
+    TraceSegment* seg = map_trace_segment(true);
+    if (!seg) {
+        fprintf(stderr, "Трассировка недоступна: не удалось отобразить %s\n", TRACE_SHM_NAME);
+        return;
+    }
+    
+    int64_t me = (int64_t)get_current_pid();
+    TraceRing* ring = nullptr;
+    for (int i = 0; i < TRACE_RINGS && !ring; i++) {
+        int64_t expected = 0;
+        if (seg->rings[i].pid.compare_exchange_strong(expected, me)) ring = &seg->rings[i];
+    }
+    
+    while (!ring) {
+        TraceRing* victim = oldest_dead_ring(seg);
+        if (!victim) {
+            fprintf(stderr, "Трассировка недоступна: все %d колец заняты работающими процессами\n", TRACE_RINGS);
+            unmap_trace_segment(seg);
+            return;
+        }
+        int64_t dead = victim->pid.load(std::memory_order_relaxed);
+        if (dead <= 0 || !victim->pid.compare_exchange_strong(dead, me)) continue;
+        
+        ring = victim;
+        for (int i = 0; i < TRACE_EVENTS; i++) ring->events[i].seq.store(0, std::memory_order_relaxed);
+        ring->head.store(0, std::memory_order_release);
+    }
+    
+    ring->attached_ns = monotonic_ns();
+    snprintf(ring->label, sizeof(ring->label), "%s", label);
+    trace_ring = ring;
+}
+
+void trace_record_at(TraceEventType type, char phase, uint64_t ts_ns, int64_t arg) {
+    TraceRing* ring = trace_ring;
+    uint64_t pos = ring->head.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent& ev = ring->events[pos % TRACE_EVENTS];
+    
+    ev.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    ev.ts_ns = ts_ns;
+    ev.arg = arg;
+    ev.tid = current_tid();
+    ev.type = (uint8_t)type;
+    ev.phase = phase;
+    ev.seq.store(pos + 1, std::memory_order_release);
+}
+
+void trace_record(TraceEventType type, char phase, int64_t arg) {
+    trace_record_at(type, phase, monotonic_ns(), arg);
+}
+
+// Копия события pos, если его не переписали во время чтения.
+static bool read_event(const TraceRing& ring, uint64_t pos, TraceEvent* out) {
+    const TraceEvent& ev = ring.events[pos % TRACE_EVENTS];
+    uint64_t seq = ev.seq.load(std::memory_order_acquire);
+    if (seq != pos + 1) return false;
+    
+    out->ts_ns = ev.ts_ns;
+    out->arg = ev.arg;
+    out->tid = ev.tid;
+    out->type = ev.type;
+    out->phase = ev.phase;
+    
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return ev.seq.load(std::memory_order_relaxed) == seq && out->type > TRACE_NONE && out->type < TRACE_TYPES;
+}
+
+long trace_dump(const char* path) {
+    TraceSegment* seg = map_trace_segment(false);
+    if (!seg) return -1;
+    
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        unmap_trace_segment(seg);
+        return -1;
+    }
+    
+    // Время в микросекундах с точностью до наносекунд.
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    long count = 0;
+    const char* sep = "";
+    
+    for (int i = 0; i < TRACE_RINGS; i++) {
+        const TraceRing& ring = seg->rings[i];
+        long long pid = (long long)ring.pid.load(std::memory_order_acquire);
+        if (pid <= 0) continue;
+        
+        fprintf(out, "%s{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%lld,\"tid\":0,\"args\":{\"name\":\"%.*s %lld\"}}",
+                sep, pid, TRACE_LABEL_SIZE, ring.label, pid);
+        sep = ",\n";
+        
+        uint64_t head = ring.head.load(std::memory_order_acquire);
+        uint64_t pos = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+        for (; pos < head; pos++) {
+            TraceEvent ev;
+            if (!read_event(ring, pos, &ev)) continue;
+            fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":%lld,\"tid\":%u,"
+                         "\"ts\":%llu.%03u,\"args\":{\"arg\":%lld}}",
+                    sep, TRACE_NAMES[ev.type], TRACE_CATEGORIES[ev.type], ev.phase, pid, ev.tid,
+                    (unsigned long long)(ev.ts_ns / 1000), (unsigned)(ev.ts_ns % 1000), (long long)ev.arg);
+            count++;
+        }
+    }
+    
+    fprintf(out, "\n]}\n");
+    bool ok = fclose(out) == 0;
+    unmap_trace_segment(seg);
+    return ok ? count : -1;
+}
+
+void trace_usage(int* rings, uint64_t* events) {
+    *rings = 0;
+    *events = 0;
+    TraceSegment* seg = map_trace_segment(false);
+    if (!seg) return;
+    
+    for (int i = 0; i < TRACE_RINGS; i++) {
+        const TraceRing& ring = seg->rings[i];
+        if (ring.pid.load(std::memory_order_acquire) <= 0) continue;
+        uint64_t head = ring.head.load(std::memory_order_relaxed);
+        (*rings)++;
+        *events += head < TRACE_EVENTS ? head : TRACE_EVENTS;
+    }
+    unmap_trace_segment(seg);
+}
@@ -0,0 +1,90 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "platform.h"
+
+// Трассировка группы процессов (COUNTER_TRACE=1): каждый процесс пишет
+// события начала и конца операций в свое кольцо в отдельном сегменте
+// разделяемой памяти, с меткой CLOCK_MONOTONIC (общие для всех процессов
+// часы). Кольцо перезаписывается по кругу и переживает процесс, поэтому
+// после завершения child1/child2 их события остаются доступны, пока кольцо
+// не займет новый процесс (сначала берутся свободные, затем кольца
+// умерших процессов, начиная с самого давнего).
+//
+// Запись события - fetch_add позиции и заполнение слота; seq слота
+// записывается последним, и читатель пропускает слоты, которые в этот
+// момент переписываются. Без COUNTER_TRACE точки трассировки сводятся к
+// проверке указателя.
+//
+// trace_dump() собирает все кольца в JSON формата Chrome trace events,
+// который открывают Perfetto (ui.perfetto.dev) и chrome://tracing.
+#ifdef _WIN32
+    #define TRACE_SHM_NAME "CounterTrace"
+#else
+    #define TRACE_SHM_NAME "/counter_trace"
+#endif
+
+#define TRACE_RINGS 64
+#define TRACE_EVENTS 4096
+#define TRACE_LABEL_SIZE 16
+
+enum TraceEventType {
+    TRACE_NONE,
+    TRACE_LOCK_WAIT,  // ожидание занятого Mutex
+    TRACE_LOCK_HOLD,  // удержание Mutex
+    TRACE_INCREMENT,  // counter_add; arg - прибавка
+    TRACE_APPLY,      // counter_apply; arg начала - вид первой операции, конца - новое значение
+    TRACE_SET,        // counter_set; arg - значение
+    TRACE_SPAWN,      // запуск child1/child2; arg конца - сколько запущено
+    TRACE_CHILD1,     // задание child1; arg конца - значение счетчика
+    TRACE_CHILD2,     // задание child2; arg конца - значение счетчика
+    TRACE_LOG_FLUSH,  // проход потока записи лога; arg конца - строк
+    TRACE_TYPES
+};
+
+struct TraceEvent {
+    std::atomic<uint64_t> seq;
+    uint64_t ts_ns;
+    int64_t arg;
+    uint32_t tid;
+    uint8_t type;
+    char phase;
+    uint16_t reserved;
+};
+
+struct alignas(64) TraceRing {
+    std::atomic<int64_t> pid;
+    std::atomic<uint64_t> head;
+    uint64_t attached_ns;
+    char label[TRACE_LABEL_SIZE];
+    TraceEvent events[TRACE_EVENTS];
+};
+
+struct TraceSegment {
+    TraceRing rings[TRACE_RINGS];
+};
+
+extern TraceRing* trace_ring;
+
+// Занимает кольцо процесса, если задано COUNTER_TRACE=1; label - роль
+// процесса в выгрузке (main, child1, worker...).
+void trace_attach(const char* label);
+void trace_record(TraceEventType type, char phase, int64_t arg);
+void trace_record_at(TraceEventType type, char phase, uint64_t ts_ns, int64_t arg);
+
+inline void trace_begin(TraceEventType type, int64_t arg = 0) {
+    if (trace_ring) trace_record(type, 'B', arg);
+}
+
+inline void trace_end(TraceEventType type, int64_t arg = 0) {
+    if (trace_ring) trace_record(type, 'E', arg);
+}
+
+// Пишет события всех колец в path; возвращает их число или -1, если
+// сегмента нет (ни один процесс не запущен с COUNTER_TRACE=1) или файл не
+// открыть.
+long trace_dump(const char* path);
+// Число занятых колец и событий в них (для команды trace).
+void trace_usage(int* rings, uint64_t* events);
+
+#endif